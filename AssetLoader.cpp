@@ -0,0 +1,143 @@
+#include "AssetLoader.h"
+#include "Profiler.h"
+
+AssetLoader::AssetLoader()
+{
+	StartWorkers(std::thread::hardware_concurrency());
+}
+
+AssetLoader::AssetLoader(unsigned int workerCount)
+{
+	StartWorkers(workerCount);
+}
+
+void AssetLoader::StartWorkers(unsigned int workerCount)
+{
+	outstandingJobs = 0;
+	stopping = false;
+
+	// hardware_concurrency() may report 0 when it can't tell
+	if (workerCount == 0)
+	{
+		workerCount = 1;
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+	}
+}
+
+void AssetLoader::Submit(std::function<void()> work, std::function<void()> upload)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		Job job;
+		job.work = work;
+		job.upload = upload;
+		pendingJobs.push_back(job);
+		outstandingJobs++;
+	}
+
+	workAvailable.notify_one();
+}
+
+void AssetLoader::WorkerLoop()
+{
+	Profiler::SetThreadName("asset worker");
+
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			workAvailable.wait(lock, [this]() { return stopping || !pendingJobs.empty(); });
+
+			if (pendingJobs.empty())
+			{
+				return;
+			}
+
+			job = pendingJobs.front();
+			pendingJobs.pop_front();
+		}
+
+		if (job.work)
+		{
+			job.work();
+		}
+
+		// Let go of what the job captured before its upload can run, so the last reference to an
+		// asset is always dropped on the main thread, which owns the GL objects it frees
+		job.work = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			readyUploads.push_back(std::move(job.upload));
+		}
+
+		uploadAvailable.notify_one();
+	}
+}
+
+unsigned int AssetLoader::PumpUploads()
+{
+	std::deque<std::function<void()>> uploads;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		uploads.swap(readyUploads);
+	}
+
+	for (size_t i = 0; i < uploads.size(); i++)
+	{
+		if (uploads[i])
+		{
+			uploads[i]();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		outstandingJobs -= (unsigned int)uploads.size();
+	}
+
+	return (unsigned int)uploads.size();
+}
+
+void AssetLoader::WaitAll()
+{
+	PROFILE_ZONE("AssetLoader::WaitAll");
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			if (outstandingJobs == 0)
+			{
+				return;
+			}
+
+			uploadAvailable.wait(lock, [this]() { return !readyUploads.empty(); });
+		}
+
+		PumpUploads();
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+
+	workAvailable.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Worker pool for startup asset work
+//
+// Each job has two halves: work() runs on a worker thread and must not touch GL, upload() runs
+// later on the GL thread from PumpUploads()/WaitAll() so uploads happen as results arrive.
+class AssetLoader
+{
+public:
+	AssetLoader(); // one worker per hardware thread
+
+	AssetLoader(unsigned int workerCount);
+
+	void Submit(std::function<void()> work, std::function<void()> upload);
+
+	// Runs the uploads of finished jobs on the calling thread without blocking; returns how many ran
+	unsigned int PumpUploads();
+
+	// Blocks until every submitted job has been uploaded
+	void WaitAll();
+
+	unsigned int GetWorkerCount() { return (unsigned int)workers.size(); }
+
+	~AssetLoader();
+
+private:
+	struct Job
+	{
+		std::function<void()> work;
+		std::function<void()> upload;
+	};
+
+	std::vector<std::thread> workers;
+
+	std::mutex queueMutex;
+	std::condition_variable workAvailable;
+	std::condition_variable uploadAvailable;
+
+	std::deque<Job> pendingJobs;
+	std::deque<std::function<void()>> readyUploads;
+	unsigned int outstandingJobs; // submitted but not uploaded yet
+	bool stopping;
+
+	void StartWorkers(unsigned int workerCount);
+	void WorkerLoop();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+};
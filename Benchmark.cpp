@@ -0,0 +1,138 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+
+Benchmark::Benchmark()
+{
+	enabled = false;
+	frames = 0;
+	warmup = 0;
+	frameIndex = 0;
+	timeStep = 0.0f;
+}
+
+Benchmark::Benchmark(unsigned int measuredFrames, unsigned int warmupFrames, GLfloat fixedTimeStep, const char** stageNames, unsigned int numStages)
+{
+	enabled = true;
+	frames = measuredFrames;
+	warmup = warmupFrames;
+	frameIndex = 0;
+	timeStep = fixedTimeStep;
+
+	stages.assign(stageNames, stageNames + numStages);
+
+	frameTimes.reserve(frames);
+	stageTimes.reserve(frames * numStages);
+	currentStageTimes.assign(numStages, 0.0);
+}
+
+void Benchmark::GetCameraPose(unsigned int frame, glm::vec3& position, GLfloat& yaw, GLfloat& pitch)
+{
+	// Orbit the middle of the desk once every 20 simulated seconds
+	const glm::vec3 target(-1.0f, -0.5f, -2.0f);
+	const GLfloat radius = 5.0f;
+	const GLfloat height = 1.5f;
+
+	GLfloat angle = frame * timeStep * (2.0f * glm::pi<float>() / 20.0f);
+
+	position = target + glm::vec3(radius * cosf(angle), height, radius * sinf(angle));
+
+	// Convert the look direction back into the yaw/pitch convention used by Camera
+	glm::vec3 direction = glm::normalize(target - position);
+	yaw = glm::degrees(atan2f(direction.z, direction.x));
+	pitch = glm::degrees(asinf(direction.y));
+}
+
+void Benchmark::BeginFrame()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	frameStart = Clock::now();
+	lastMark = frameStart;
+	std::fill(currentStageTimes.begin(), currentStageTimes.end(), 0.0);
+}
+
+void Benchmark::EndStage(unsigned int stage)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	Clock::time_point now = Clock::now();
+	currentStageTimes[stage] += std::chrono::duration<double, std::milli>(now - lastMark).count();
+	lastMark = now;
+}
+
+void Benchmark::EndFrame()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// Warmup frames absorb shader compilation and driver first-use costs
+	if (frameIndex++ < warmup)
+	{
+		return;
+	}
+
+	frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+	stageTimes.insert(stageTimes.end(), currentStageTimes.begin(), currentStageTimes.end());
+}
+
+double Benchmark::Percentile(std::vector<double> samples, double percent)
+{
+	if (samples.empty())
+	{
+		return 0.0;
+	}
+
+	// Nearest-rank percentile
+	std::sort(samples.begin(), samples.end());
+	size_t rank = (size_t)ceil(percent / 100.0 * samples.size());
+	rank = std::min(std::max(rank, (size_t)1), samples.size());
+
+	return samples[rank - 1];
+}
+
+void Benchmark::PrintReport()
+{
+	if (!enabled || frameTimes.empty())
+	{
+		return;
+	}
+
+	printf("\nBenchmark: %u frames measured (%u warmup), fixed timestep %.2f ms\n",
+		(unsigned int)frameTimes.size(), warmup, timeStep * 1000.0f);
+
+	printf("Frame time (ms):  min %.3f | median %.3f | p95 %.3f | p99 %.3f | max %.3f\n",
+		Percentile(frameTimes, 0.0), Percentile(frameTimes, 50.0), Percentile(frameTimes, 95.0),
+		Percentile(frameTimes, 99.0), Percentile(frameTimes, 100.0));
+
+	printf("CPU time by stage (ms):     mean   median      p95\n");
+
+	size_t numStages = stages.size();
+	std::vector<double> samples(frameTimes.size());
+
+	for (size_t stage = 0; stage < numStages; stage++)
+	{
+		double sum = 0.0;
+		for (size_t frame = 0; frame < frameTimes.size(); frame++)
+		{
+			samples[frame] = stageTimes[frame * numStages + stage];
+			sum += samples[frame];
+		}
+
+		printf("  %-20s %8.3f %8.3f %8.3f\n", stages[stage],
+			sum / samples.size(), Percentile(samples, 50.0), Percentile(samples, 95.0));
+	}
+}
+
+Benchmark::~Benchmark()
+{
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class Benchmark
+{
+public:
+	Benchmark(); // disabled - every call is a no-op
+
+	Benchmark(unsigned int measuredFrames, unsigned int warmupFrames, GLfloat fixedTimeStep, const char** stageNames, unsigned int numStages);
+
+	bool IsEnabled() { return enabled; }
+
+	// Total frames to run, warmup included
+	unsigned int GetFrameLimit() { return warmup + frames; }
+	GLfloat GetTimeStep() { return timeStep; }
+
+	// Scripted camera path: a slow orbit around the desk, driven only by the frame index
+	void GetCameraPose(unsigned int frame, glm::vec3& position, GLfloat& yaw, GLfloat& pitch);
+
+	// Marks the start of a frame; each EndStage() charges the time since the previous mark to that stage
+	void BeginFrame();
+	void EndStage(unsigned int stage);
+	void EndFrame();
+
+	void PrintReport();
+
+	~Benchmark();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	bool enabled;
+	unsigned int frames, warmup, frameIndex;
+	GLfloat timeStep;
+
+	std::vector<const char*> stages;
+
+	Clock::time_point frameStart, lastMark;
+
+	std::vector<double> frameTimes;  // milliseconds, one per measured frame
+	std::vector<double> stageTimes;  // milliseconds, frames x stages
+	std::vector<double> currentStageTimes;
+
+	static double Percentile(std::vector<double> samples, double percent);
+};
+
@@ -63,6 +63,15 @@ void Camera::mouseControl(GLfloat xChange, GLfloat yChange)
 	update();
 }
 
+void Camera::setPose(glm::vec3 newPosition, GLfloat newYaw, GLfloat newPitch)
+{
+	position = newPosition;
+	yaw = newYaw;
+	pitch = newPitch;
+
+	update();
+}
+
 glm::mat4 Camera::calculateViewMatrix()
 {
 	return glm::lookAt(position, position + front, up);
@@ -16,6 +16,9 @@ public:
 	void keyControl(bool* keys, GLfloat deltaTime);
 	void mouseControl(GLfloat xChange, GLfloat yChange);
 
+	// Places the camera directly, bypassing input (used for scripted camera paths)
+	void setPose(glm::vec3 newPosition, GLfloat newYaw, GLfloat newPitch);
+
 	glm::vec3 getCameraPosition();
 
 	glm::mat4 calculateViewMatrix();
@@ -0,0 +1,954 @@
+#include "CompressedImage.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+
+namespace
+{
+	struct FormatInfo
+	{
+		GLenum format;
+		uint32_t vkFormat;   // KTX2
+		uint32_t dxgiFormat; // DDS with a DX10 header, 0 if DDS can't hold it
+		size_t blockSize;
+		bool sRGB;
+		const char* name;
+
+		// KTX2 data format descriptor: color model and the channel ids of the color and alpha samples
+		uint8_t colorModel, colorChannel, alphaChannel;
+	};
+
+	const uint8_t NO_CHANNEL = 0xFF;
+
+	const FormatInfo FORMATS[] =
+	{
+		{ GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 131, 0, 8, false, "BC1", 128, 0, NO_CHANNEL },
+		{ GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 132, 0, 8, true, "BC1 sRGB", 128, 0, NO_CHANNEL },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 133, 71, 8, false, "BC1 RGBA", 128, 1, NO_CHANNEL },
+		{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 134, 72, 8, true, "BC1 RGBA sRGB", 128, 1, NO_CHANNEL },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 137, 77, 16, false, "BC3", 130, 0, 15 },
+		{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 138, 78, 16, true, "BC3 sRGB", 130, 0, 15 },
+		{ GL_COMPRESSED_RGBA_BPTC_UNORM, 145, 98, 16, false, "BC7", 134, 0, NO_CHANNEL },
+		{ GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 146, 99, 16, true, "BC7 sRGB", 134, 0, NO_CHANNEL },
+		{ GL_COMPRESSED_RGB8_ETC2, 147, 0, 8, false, "ETC2 RGB", 161, 2, NO_CHANNEL },
+		{ GL_COMPRESSED_SRGB8_ETC2, 148, 0, 8, true, "ETC2 RGB sRGB", 161, 2, NO_CHANNEL },
+		{ GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 149, 0, 8, false, "ETC2 RGB A1", 161, 2, NO_CHANNEL },
+		{ GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 150, 0, 8, true, "ETC2 RGB A1 sRGB", 161, 2, NO_CHANNEL },
+		{ GL_COMPRESSED_RGBA8_ETC2_EAC, 151, 0, 16, false, "ETC2 RGBA", 161, 2, 15 },
+		{ GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 152, 0, 16, true, "ETC2 RGBA sRGB", 161, 2, 15 },
+	};
+
+	const size_t FORMAT_COUNT = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const size_t KTX2_HEADER_SIZE = 80;
+	const size_t KTX2_LEVEL_ENTRY_SIZE = 24;
+
+	const size_t DDS_HEADER_SIZE = 128; // magic included
+	const size_t DDS_DX10_HEADER_SIZE = 20;
+	const uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+	const uint32_t DDS_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+	constexpr uint32_t FourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+	}
+
+	const FormatInfo* FindFormat(GLenum format)
+	{
+		for (size_t i = 0; i < FORMAT_COUNT; i++)
+		{
+			if (FORMATS[i].format == format)
+			{
+				return &FORMATS[i];
+			}
+		}
+
+		return NULL;
+	}
+
+	// Both containers are little-endian, like every platform this builds for
+	uint32_t Read32(const unsigned char* bytes)
+	{
+		uint32_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	uint64_t Read64(const unsigned char* bytes)
+	{
+		uint64_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	void Write8(std::vector<unsigned char>& out, uint8_t value)
+	{
+		out.push_back(value);
+	}
+
+	void Write16(std::vector<unsigned char>& out, uint16_t value)
+	{
+		out.insert(out.end(), (unsigned char*)&value, (unsigned char*)&value + sizeof(value));
+	}
+
+	void Write32(std::vector<unsigned char>& out, uint32_t value)
+	{
+		out.insert(out.end(), (unsigned char*)&value, (unsigned char*)&value + sizeof(value));
+	}
+
+	void Write64(std::vector<unsigned char>& out, uint64_t value)
+	{
+		out.insert(out.end(), (unsigned char*)&value, (unsigned char*)&value + sizeof(value));
+	}
+
+	void Pad(std::vector<unsigned char>& out, size_t alignment)
+	{
+		while (out.size() % alignment != 0)
+		{
+			out.push_back(0);
+		}
+	}
+
+	// Up to maxBytes (all of it when 0) in one read
+	bool ReadFileBytes(const char* fileLocation, std::vector<unsigned char>& bytes, size_t maxBytes)
+	{
+		FILE* file = fopen(fileLocation, "rb");
+		if (file == NULL)
+		{
+			printf("Failed to find: %s\n", fileLocation);
+			return false;
+		}
+
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		size_t wanted = size > 0 ? (size_t)size : 0;
+		if (maxBytes > 0 && wanted > maxBytes)
+		{
+			wanted = maxBytes;
+		}
+
+		bytes.resize(wanted);
+		bytes.resize(wanted > 0 ? fread(bytes.data(), 1, wanted, file) : 0);
+		fclose(file);
+
+		return true;
+	}
+
+	// Headers are untrusted: the size must be positive and the level count no more than a full mip chain
+	// down to 1x1 (which also keeps every width >> level shift below 32)
+	bool CheckImageSize(const char* fileLocation, const CompressedImage& image, unsigned int levelCount)
+	{
+		if (image.width <= 0 || image.height <= 0)
+		{
+			printf("%s: bad image size %dx%d\n", fileLocation, image.width, image.height);
+			return false;
+		}
+
+		unsigned int maxLevels = 1;
+		for (int size = image.width > image.height ? image.width : image.height; size > 1; size >>= 1)
+		{
+			maxLevels++;
+		}
+
+		if (levelCount > maxLevels)
+		{
+			printf("%s: %u mip levels, a %dx%d image has at most %u\n", fileLocation, levelCount, image.width, image.height, maxLevels);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Rows of a block map r -> rows - 1 - r; rows is 4 for whole blocks, or the level height when it's
+	// below 4 and the rest of the block is padding that stays put
+	int FlipRow(int row, int rows)
+	{
+		return row < rows ? rows - 1 - row : row;
+	}
+
+	// BC1 color indices: one byte per row, after the two endpoints
+	void FlipBC1Block(unsigned char* block, int rows)
+	{
+		unsigned char indices[4];
+		memcpy(indices, block + 4, 4);
+		for (int row = 0; row < 4; row++)
+		{
+			block[4 + FlipRow(row, rows)] = indices[row];
+		}
+	}
+
+	// BC3 alpha indices: 48 little-endian bits after the two endpoints, 12 per row
+	void FlipBC3AlphaBlock(unsigned char* block, int rows)
+	{
+		uint64_t indices = 0, flipped = 0;
+		memcpy(&indices, block + 2, 6);
+		for (int row = 0; row < 4; row++)
+		{
+			flipped |= ((indices >> (12 * row)) & 0xFFF) << (12 * FlipRow(row, rows));
+		}
+		memcpy(block + 2, &flipped, 6);
+	}
+
+	// ETC2 and EAC blocks are big-endian 64-bit words
+	uint64_t ReadBigEndian64(const unsigned char* bytes)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			value = (value << 8) | bytes[i];
+		}
+		return value;
+	}
+
+	void WriteBigEndian64(unsigned char* bytes, uint64_t value)
+	{
+		for (int i = 7; i >= 0; i--)
+		{
+			bytes[i] = (unsigned char)value;
+			value >>= 8;
+		}
+	}
+
+	// EAC alpha indices: 3 bits per texel from bit 45 down, texel x * 4 + y (columns of four)
+	void FlipEACAlphaBlock(unsigned char* block, int rows)
+	{
+		uint64_t word = ReadBigEndian64(block);
+		uint64_t flipped = word & 0xFFFF000000000000ull;
+		for (int x = 0; x < 4; x++)
+		{
+			for (int y = 0; y < 4; y++)
+			{
+				uint64_t index = (word >> (45 - 3 * (x * 4 + y))) & 7;
+				flipped |= index << (45 - 3 * (x * 4 + FlipRow(y, rows)));
+			}
+		}
+		WriteBigEndian64(block, flipped);
+	}
+
+	int SignExtend3(uint64_t value)
+	{
+		return value & 4 ? (int)value - 8 : (int)value;
+	}
+
+	// ETC2 color block: two index bit planes, texel x * 4 + y in each. The header only changes when the
+	// block is split into a top and a bottom half (flip bit set) and those halves swap: individual mode
+	// swaps the two colors and tables, differential mode rebases on the second color and negates the
+	// delta, which fails for a delta of -4. T and H mode colors don't depend on the texel position;
+	// planar mode's gradient would need new colors that can't be stored exactly. In punch-through
+	// blocks bit 33 is the opaque flag and every block is differential.
+	bool FlipETC2Block(unsigned char* block, int rows, bool punchThrough)
+	{
+		uint64_t word = ReadBigEndian64(block);
+
+		bool differential = punchThrough || (word >> 33) & 1;
+		bool planar = false, colorsByPosition = true;
+		if (differential)
+		{
+			int red = (int)((word >> 59) & 31) + SignExtend3((word >> 56) & 7);
+			int green = (int)((word >> 51) & 31) + SignExtend3((word >> 48) & 7);
+			int blue = (int)((word >> 43) & 31) + SignExtend3((word >> 40) & 7);
+
+			// The first channel to overflow picks T, H or planar mode
+			colorsByPosition = red >= 0 && red <= 31 && green >= 0 && green <= 31;
+			planar = colorsByPosition && (blue < 0 || blue > 31);
+			colorsByPosition = colorsByPosition && !planar;
+		}
+
+		if (planar && rows > 1)
+		{
+			return false;
+		}
+
+		bool swapHalves = colorsByPosition && ((word >> 32) & 1) && rows > 2;
+		if (swapHalves && rows != 4)
+		{
+			return false; // three rows: the middle one would have to change halves on its own
+		}
+
+		uint64_t flipped = word & 0xFFFFFFFF00000000ull;
+		if (swapHalves)
+		{
+			// Tables: bits 39-37 and 36-34
+			flipped &= ~(0x3Full << 34);
+			flipped |= ((word >> 37) & 7) << 34 | ((word >> 34) & 7) << 37;
+
+			for (int shift = 56; shift >= 40; shift -= 8)
+			{
+				flipped &= ~(0xFFull << shift);
+				if (differential)
+				{
+					int base = (int)((word >> (shift + 3)) & 31);
+					int delta = SignExtend3((word >> shift) & 7);
+					if (delta == -4)
+					{
+						return false;
+					}
+					flipped |= (uint64_t)(base + delta) << (shift + 3) | (uint64_t)(-delta & 7) << shift;
+				}
+				else
+				{
+					flipped |= ((word >> shift) & 15) << (shift + 4) | ((word >> (shift + 4)) & 15) << shift;
+				}
+			}
+		}
+
+		for (int plane = 0; plane < 32; plane += 16)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				for (int y = 0; y < 4; y++)
+				{
+					flipped |= ((word >> (plane + x * 4 + y)) & 1) << (plane + x * 4 + FlipRow(y, rows));
+				}
+			}
+		}
+
+		WriteBigEndian64(block, flipped);
+		return true;
+	}
+
+	bool FlipBlock(GLenum format, unsigned char* block, int rows)
+	{
+		switch (format)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+			FlipBC1Block(block, rows);
+			return true;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+			FlipBC3AlphaBlock(block, rows);
+			FlipBC1Block(block + 8, rows);
+			return true;
+		case GL_COMPRESSED_RGB8_ETC2:
+		case GL_COMPRESSED_SRGB8_ETC2:
+			return FlipETC2Block(block, rows, false);
+		case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			return FlipETC2Block(block, rows, true);
+		case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+			FlipEACAlphaBlock(block, rows);
+			return FlipETC2Block(block + 8, rows, false);
+		default:
+			return false; // BC7 modes each lay their texels out differently
+		}
+	}
+
+	bool CanFlipFormat(GLenum format)
+	{
+		return format != GL_COMPRESSED_RGBA_BPTC_UNORM && format != GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+	}
+
+	// Turns top-down rows into bottom-up ones or back, in place; false (with a message) if a block can't be flipped
+	bool FlipImageRows(const char* fileLocation, CompressedImage& image)
+	{
+		if (!CanFlipFormat(image.format))
+		{
+			printf("%s: %s blocks can't be flipped between top-down and bottom-up rows\n", fileLocation, GetCompressedFormatName(image.format));
+			return false;
+		}
+
+		size_t blockSize = GetCompressedBlockSize(image.format);
+		for (size_t level = 0; level < image.levels.size(); level++)
+		{
+			const CompressedLevel& entry = image.levels[level];
+			size_t blocksWide = ((size_t)entry.width + 3) / 4, blocksHigh = ((size_t)entry.height + 3) / 4;
+			size_t rowSize = blocksWide * blockSize;
+			unsigned char* data = &image.data[entry.offset];
+
+			for (size_t row = 0; row < blocksHigh / 2; row++)
+			{
+				std::swap_ranges(data + row * rowSize, data + (row + 1) * rowSize, data + (blocksHigh - 1 - row) * rowSize);
+			}
+
+			int rows = entry.height < 4 ? entry.height : 4;
+			for (size_t block = 0; block < blocksWide * blocksHigh; block++)
+			{
+				if (!FlipBlock(image.format, data + block * blockSize, rows))
+				{
+					printf("%s: mip level %zu has a %s block that can't be flipped between top-down and bottom-up rows\n",
+						fileLocation, level, GetCompressedFormatName(image.format));
+					return false;
+				}
+			}
+		}
+
+		image.topDown = !image.topDown;
+		return true;
+	}
+
+	// KTX2 rows are top-down unless KTXorientation says otherwise. The key/value data has to be within bytes.
+	bool ParseKTX2Orientation(const std::vector<unsigned char>& bytes, const char* fileLocation, CompressedImage& image)
+	{
+		size_t kvdOffset = Read32(&bytes[56]), kvdLength = Read32(&bytes[60]);
+		if (kvdOffset > bytes.size() || kvdLength > bytes.size() - kvdOffset)
+		{
+			printf("%s is truncated\n", fileLocation);
+			return false;
+		}
+
+		image.topDown = true;
+		for (size_t offset = kvdOffset; offset + 4 <= kvdOffset + kvdLength;)
+		{
+			size_t entryLength = Read32(&bytes[offset]);
+			if (entryLength > kvdOffset + kvdLength - offset - 4)
+			{
+				printf("%s: bad key/value data\n", fileLocation);
+				return false;
+			}
+
+			const char* key = (const char*)&bytes[offset + 4];
+			size_t keyLength = strnlen(key, entryLength);
+			if (keyLength < entryLength && strcmp(key, "KTXorientation") == 0)
+			{
+				std::string value(key + keyLength + 1, strnlen(key + keyLength + 1, entryLength - keyLength - 1));
+				if (!value.empty() && value[0] != 'r')
+				{
+					printf("%s: mirrored images (KTXorientation %s) are not supported\n", fileLocation, value.c_str());
+					return false;
+				}
+
+				image.topDown = value.size() < 2 || value[1] != 'u';
+			}
+
+			offset += 4 + (entryLength + 3) / 4 * 4;
+		}
+
+		return true;
+	}
+
+	// Fills format and size from a DDS header; dataOffset is where level 0 starts
+	bool ParseDDSHeader(const std::vector<unsigned char>& bytes, const char* fileLocation, CompressedImage& image, unsigned int& levelCount, size_t& dataOffset)
+	{
+		if (bytes.size() < DDS_HEADER_SIZE || Read32(&bytes[0]) != FourCC('D', 'D', 'S', ' ') || Read32(&bytes[4]) != 124)
+		{
+			printf("%s is not a DDS file\n", fileLocation);
+			return false;
+		}
+
+		image.height = (int)Read32(&bytes[12]);
+		image.width = (int)Read32(&bytes[16]);
+		image.topDown = true; // DDS has no way to say otherwise
+		levelCount = Read32(&bytes[28]) > 0 ? Read32(&bytes[28]) : 1;
+		if (!CheckImageSize(fileLocation, image, levelCount))
+		{
+			return false;
+		}
+
+		uint32_t pixelFlags = Read32(&bytes[80]);
+		uint32_t fourCC = Read32(&bytes[84]);
+		uint32_t caps2 = Read32(&bytes[112]);
+		dataOffset = DDS_HEADER_SIZE;
+
+		if (caps2 & DDSCAPS2_CUBEMAP)
+		{
+			printf("%s: cube maps are not supported\n", fileLocation);
+			return false;
+		}
+
+		image.format = 0;
+		if (!(pixelFlags & DDPF_FOURCC))
+		{
+			printf("%s: uncompressed DDS files are not supported\n", fileLocation);
+			return false;
+		}
+		else if (fourCC == FourCC('D', 'X', 'T', '1'))
+		{
+			image.format = (pixelFlags & DDPF_ALPHAPIXELS) ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		}
+		else if (fourCC == FourCC('D', 'X', 'T', '5'))
+		{
+			image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		}
+		else if (fourCC == FourCC('D', 'X', '1', '0'))
+		{
+			if (bytes.size() < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+			{
+				printf("%s is truncated\n", fileLocation);
+				return false;
+			}
+
+			uint32_t dxgiFormat = Read32(&bytes[128]);
+			if (Read32(&bytes[132]) != DDS_RESOURCE_DIMENSION_TEXTURE2D || Read32(&bytes[140]) > 1)
+			{
+				printf("%s: only single 2D textures are supported\n", fileLocation);
+				return false;
+			}
+
+			for (size_t i = 0; i < FORMAT_COUNT; i++)
+			{
+				if (FORMATS[i].dxgiFormat != 0 && FORMATS[i].dxgiFormat == dxgiFormat)
+				{
+					image.format = FORMATS[i].format;
+				}
+			}
+			dataOffset += DDS_DX10_HEADER_SIZE;
+		}
+
+		if (image.format == 0)
+		{
+			printf("%s: unsupported DDS pixel format\n", fileLocation);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool ParseKTX2Header(const std::vector<unsigned char>& bytes, const char* fileLocation, CompressedImage& image, unsigned int& levelCount)
+	{
+		if (bytes.size() < KTX2_HEADER_SIZE || memcmp(&bytes[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		{
+			printf("%s is not a KTX2 file\n", fileLocation);
+			return false;
+		}
+
+		uint32_t vkFormat = Read32(&bytes[12]);
+		image.width = (int)Read32(&bytes[20]);
+		image.height = (int)Read32(&bytes[24]);
+		uint32_t depth = Read32(&bytes[28]);
+		uint32_t layerCount = Read32(&bytes[32]);
+		uint32_t faceCount = Read32(&bytes[36]);
+		levelCount = Read32(&bytes[40]) > 0 ? Read32(&bytes[40]) : 1;
+		uint32_t supercompression = Read32(&bytes[44]);
+
+		if (!CheckImageSize(fileLocation, image, levelCount))
+		{
+			return false;
+		}
+
+		if (depth > 0 || layerCount > 1 || faceCount != 1)
+		{
+			printf("%s: only single 2D textures are supported\n", fileLocation);
+			return false;
+		}
+		if (supercompression != 0)
+		{
+			printf("%s: supercompressed KTX2 (scheme %u) is not supported\n", fileLocation, supercompression);
+			return false;
+		}
+
+		image.format = 0;
+		for (size_t i = 0; i < FORMAT_COUNT; i++)
+		{
+			if (FORMATS[i].vkFormat == vkFormat)
+			{
+				image.format = FORMATS[i].format;
+			}
+		}
+
+		if (image.format == 0)
+		{
+			printf("%s: unsupported KTX2 format (VkFormat %u)\n", fileLocation, vkFormat);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool LoadDDS(const char* fileLocation, std::vector<unsigned char>& bytes, CompressedImage& image)
+	{
+		unsigned int levelCount = 0;
+		size_t offset = 0;
+		if (!ParseDDSHeader(bytes, fileLocation, image, levelCount, offset))
+		{
+			return false;
+		}
+
+		// Levels follow each other, largest first
+		for (unsigned int level = 0; level < levelCount; level++)
+		{
+			CompressedLevel entry;
+			entry.width = image.width >> level > 0 ? image.width >> level : 1;
+			entry.height = image.height >> level > 0 ? image.height >> level : 1;
+			entry.offset = offset;
+			entry.size = GetCompressedLevelSize(image.format, entry.width, entry.height);
+
+			if (entry.offset + entry.size > bytes.size())
+			{
+				printf("%s is truncated at mip level %u\n", fileLocation, level);
+				return false;
+			}
+
+			image.levels.push_back(entry);
+			offset += entry.size;
+		}
+
+		image.data.swap(bytes);
+		return true;
+	}
+
+	bool LoadKTX2(const char* fileLocation, std::vector<unsigned char>& bytes, CompressedImage& image)
+	{
+		unsigned int levelCount = 0;
+		if (!ParseKTX2Header(bytes, fileLocation, image, levelCount) || !ParseKTX2Orientation(bytes, fileLocation, image))
+		{
+			return false;
+		}
+
+		if (bytes.size() < KTX2_HEADER_SIZE + (size_t)levelCount * KTX2_LEVEL_ENTRY_SIZE)
+		{
+			printf("%s is truncated\n", fileLocation);
+			return false;
+		}
+
+		for (unsigned int level = 0; level < levelCount; level++)
+		{
+			const unsigned char* indexEntry = &bytes[KTX2_HEADER_SIZE + (size_t)level * KTX2_LEVEL_ENTRY_SIZE];
+
+			CompressedLevel entry;
+			entry.width = image.width >> level > 0 ? image.width >> level : 1;
+			entry.height = image.height >> level > 0 ? image.height >> level : 1;
+			entry.offset = (size_t)Read64(indexEntry);
+			entry.size = (size_t)Read64(indexEntry + 8);
+
+			// Both come from the file, so compared without a sum that could wrap
+			if (entry.size != GetCompressedLevelSize(image.format, entry.width, entry.height) ||
+				entry.offset > bytes.size() || entry.size > bytes.size() - entry.offset)
+			{
+				printf("%s: mip level %u has a bad size or is truncated\n", fileLocation, level);
+				return false;
+			}
+
+			image.levels.push_back(entry);
+		}
+
+		image.data.swap(bytes);
+		return true;
+	}
+
+	bool SaveDDS(FILE* file, const char* fileLocation, const CompressedImage& image, const FormatInfo* info)
+	{
+		std::vector<unsigned char> header;
+
+		// Legacy FourCC headers for what older readers know, a DX10 header for the rest
+		uint32_t fourCC = FourCC('D', 'X', '1', '0');
+		if (image.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+		{
+			fourCC = FourCC('D', 'X', 'T', '1');
+		}
+		else if (image.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+		{
+			fourCC = FourCC('D', 'X', 'T', '5');
+		}
+		else if (info->dxgiFormat == 0)
+		{
+			printf("%s can't be stored in a DDS file\n", info->name);
+			return false;
+		}
+
+		const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+		const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+		bool mipmapped = image.levels.size() > 1;
+
+		Write32(header, FourCC('D', 'D', 'S', ' '));
+		Write32(header, 124);
+		Write32(header, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | (mipmapped ? DDSD_MIPMAPCOUNT : 0));
+		Write32(header, (uint32_t)image.height);
+		Write32(header, (uint32_t)image.width);
+		Write32(header, (uint32_t)image.levels[0].size);
+		Write32(header, 0); // depth
+		Write32(header, (uint32_t)image.levels.size());
+		for (int i = 0; i < 11; i++)
+		{
+			Write32(header, 0);
+		}
+
+		Write32(header, 32);
+		Write32(header, DDPF_FOURCC);
+		Write32(header, fourCC);
+		for (int i = 0; i < 5; i++)
+		{
+			Write32(header, 0); // bit count and masks
+		}
+
+		Write32(header, DDSCAPS_TEXTURE | (mipmapped ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+		for (int i = 0; i < 4; i++)
+		{
+			Write32(header, 0);
+		}
+
+		if (fourCC == FourCC('D', 'X', '1', '0'))
+		{
+			Write32(header, info->dxgiFormat);
+			Write32(header, DDS_RESOURCE_DIMENSION_TEXTURE2D);
+			Write32(header, 0);
+			Write32(header, 1);
+			Write32(header, 0);
+		}
+
+		// Every DDS reader expects top-down rows
+		CompressedImage flipped;
+		const CompressedImage* topDownImage = &image;
+		if (!image.topDown)
+		{
+			flipped = image;
+			if (!FlipImageRows(fileLocation, flipped))
+			{
+				return false;
+			}
+			topDownImage = &flipped;
+		}
+
+		if (fwrite(header.data(), 1, header.size(), file) != header.size())
+		{
+			return false;
+		}
+
+		for (size_t level = 0; level < topDownImage->levels.size(); level++)
+		{
+			const CompressedLevel& entry = topDownImage->levels[level];
+			if (fwrite(&topDownImage->data[entry.offset], 1, entry.size, file) != entry.size)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool SaveKTX2(FILE* file, const CompressedImage& image, const FormatInfo* info)
+	{
+		size_t levelCount = image.levels.size();
+
+		// Basic data format descriptor: one sample covering the block, or alpha then color
+		std::vector<unsigned char> dfd;
+		unsigned int sampleCount = info->alphaChannel != NO_CHANNEL ? 2 : 1;
+		uint16_t descriptorSize = (uint16_t)(24 + 16 * sampleCount);
+
+		Write32(dfd, 4 + descriptorSize);
+		Write32(dfd, 0); // Khronos vendor, basic descriptor type
+		Write16(dfd, 2); // version
+		Write16(dfd, descriptorSize);
+		Write8(dfd, info->colorModel);
+		Write8(dfd, 1); // BT.709 primaries
+		Write8(dfd, info->sRGB ? 2 : 1); // transfer function
+		Write8(dfd, 0); // straight alpha
+		Write8(dfd, 3); // 4x4 blocks, stored minus one
+		Write8(dfd, 3);
+		Write8(dfd, 0);
+		Write8(dfd, 0);
+		Write8(dfd, (uint8_t)info->blockSize);
+		for (int i = 0; i < 7; i++)
+		{
+			Write8(dfd, 0);
+		}
+
+		unsigned int sampleBits = (unsigned int)info->blockSize * 8 / sampleCount;
+		for (unsigned int sample = 0; sample < sampleCount; sample++)
+		{
+			Write16(dfd, (uint16_t)(sample * sampleBits));
+			Write8(dfd, (uint8_t)(sampleBits - 1));
+			Write8(dfd, sampleCount == 2 && sample == 0 ? info->alphaChannel : info->colorChannel);
+			Write32(dfd, 0); // sample position
+			Write32(dfd, 0);
+			Write32(dfd, 0xFFFFFFFF);
+		}
+
+		// "rd" (right, down) for top-down rows, "ru" for bottom-up ones
+		std::vector<unsigned char> kvd;
+		const char* keyValues[2][2] = { { "KTXorientation", image.topDown ? "rd" : "ru" }, { "KTXwriter", "TextureConverter" } };
+		for (int i = 0; i < 2; i++)
+		{
+			size_t keyLength = strlen(keyValues[i][0]) + 1, valueLength = strlen(keyValues[i][1]) + 1;
+			Write32(kvd, (uint32_t)(keyLength + valueLength));
+			kvd.insert(kvd.end(), keyValues[i][0], keyValues[i][0] + keyLength);
+			kvd.insert(kvd.end(), keyValues[i][1], keyValues[i][1] + valueLength);
+			Pad(kvd, 4);
+		}
+
+		size_t dfdOffset = KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_ENTRY_SIZE;
+		size_t kvdOffset = dfdOffset + dfd.size();
+
+		// Level data goes smallest first, each level aligned to the block size
+		std::vector<size_t> levelOffsets(levelCount);
+		size_t offset = kvdOffset + kvd.size();
+		for (size_t level = levelCount; level-- > 0;)
+		{
+			offset = (offset + info->blockSize - 1) / info->blockSize * info->blockSize;
+			levelOffsets[level] = offset;
+			offset += image.levels[level].size;
+		}
+
+		std::vector<unsigned char> out(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+		Write32(out, info->vkFormat);
+		Write32(out, 1); // typeSize for block-compressed formats
+		Write32(out, (uint32_t)image.width);
+		Write32(out, (uint32_t)image.height);
+		Write32(out, 0); // depth
+		Write32(out, 0); // layers
+		Write32(out, 1); // faces
+		Write32(out, (uint32_t)levelCount);
+		Write32(out, 0); // no supercompression
+		Write32(out, (uint32_t)dfdOffset);
+		Write32(out, (uint32_t)dfd.size());
+		Write32(out, (uint32_t)kvdOffset);
+		Write32(out, (uint32_t)kvd.size());
+		Write64(out, 0); // no supercompression global data
+		Write64(out, 0);
+
+		for (size_t level = 0; level < levelCount; level++)
+		{
+			Write64(out, levelOffsets[level]);
+			Write64(out, image.levels[level].size);
+			Write64(out, image.levels[level].size);
+		}
+
+		out.insert(out.end(), dfd.begin(), dfd.end());
+		out.insert(out.end(), kvd.begin(), kvd.end());
+
+		for (size_t level = levelCount; level-- > 0;)
+		{
+			out.resize(levelOffsets[level], 0);
+			const CompressedLevel& entry = image.levels[level];
+			out.insert(out.end(), image.data.begin() + entry.offset, image.data.begin() + entry.offset + entry.size);
+		}
+
+		return fwrite(out.data(), 1, out.size(), file) == out.size();
+	}
+
+	bool HasExtension(const char* fileLocation, const char* extension)
+	{
+		size_t length = strlen(fileLocation), extensionLength = strlen(extension);
+		if (length < extensionLength)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < extensionLength; i++)
+		{
+			char c = fileLocation[length - extensionLength + i];
+			if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != extension[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+bool IsCompressedImageFile(const char* fileLocation)
+{
+	return HasExtension(fileLocation, ".ktx2") || HasExtension(fileLocation, ".dds");
+}
+
+bool LoadCompressedImage(const char* fileLocation, CompressedImage& image)
+{
+	image = CompressedImage();
+
+	std::vector<unsigned char> bytes;
+	if (!ReadFileBytes(fileLocation, bytes, 0))
+	{
+		return false;
+	}
+
+	// The levels point into the file as read; nothing is copied before the upload
+	bool loaded = HasExtension(fileLocation, ".dds") ? LoadDDS(fileLocation, bytes, image) : LoadKTX2(fileLocation, bytes, image);
+	if (loaded && image.topDown)
+	{
+		loaded = FlipImageRows(fileLocation, image);
+	}
+
+	if (!loaded)
+	{
+		image = CompressedImage();
+	}
+
+	return loaded;
+}
+
+GLenum PeekCompressedFormat(const char* fileLocation)
+{
+	std::vector<unsigned char> bytes;
+	if (!ReadFileBytes(fileLocation, bytes, DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE))
+	{
+		return 0;
+	}
+
+	CompressedImage image;
+	unsigned int levelCount = 0;
+	size_t dataOffset = 0;
+
+	bool dds = HasExtension(fileLocation, ".dds");
+	bool parsed = dds ? ParseDDSHeader(bytes, fileLocation, image, levelCount, dataOffset) : ParseKTX2Header(bytes, fileLocation, image, levelCount);
+	if (!parsed || CanFlipFormat(image.format))
+	{
+		return parsed ? image.format : 0;
+	}
+
+	// A format that can't be flipped is only usable bottom-up, which KTX2 says in its key/value data
+	if (!dds)
+	{
+		size_t kvdEnd = (size_t)Read32(&bytes[56]) + Read32(&bytes[60]);
+		parsed = ReadFileBytes(fileLocation, bytes, std::max(kvdEnd, KTX2_HEADER_SIZE)) && ParseKTX2Orientation(bytes, fileLocation, image);
+	}
+
+	if (parsed && image.topDown)
+	{
+		printf("%s: %s blocks can't be flipped between top-down and bottom-up rows\n", fileLocation, GetCompressedFormatName(image.format));
+	}
+
+	return parsed && !image.topDown ? image.format : 0;
+}
+
+bool SaveCompressedImage(const char* fileLocation, const CompressedImage& image, CompressedContainer container)
+{
+	const FormatInfo* info = FindFormat(image.format);
+	if (info == NULL || image.levels.empty())
+	{
+		printf("Nothing to save to %s\n", fileLocation);
+		return false;
+	}
+
+	// Written next to the destination and renamed, so a reader never sees half a file
+	std::string temporaryLocation = std::string(fileLocation) + ".tmp";
+	FILE* file = fopen(temporaryLocation.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("Failed to write %s\n", fileLocation);
+		return false;
+	}
+
+	bool written = container == CONTAINER_DDS ? SaveDDS(file, fileLocation, image, info) : SaveKTX2(file, image, info);
+	written = fclose(file) == 0 && written;
+
+	remove(fileLocation);
+	if (!written || rename(temporaryLocation.c_str(), fileLocation) != 0)
+	{
+		printf("Failed to write %s\n", fileLocation);
+		remove(temporaryLocation.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+size_t GetCompressedBlockSize(GLenum format)
+{
+	const FormatInfo* info = FindFormat(format);
+	return info != NULL ? info->blockSize : 0;
+}
+
+size_t GetCompressedLevelSize(GLenum format, int width, int height)
+{
+	size_t blocksWide = width > 0 ? ((size_t)width + 3) / 4 : 1;
+	size_t blocksHigh = height > 0 ? ((size_t)height + 3) / 4 : 1;
+
+	return blocksWide * blocksHigh * GetCompressedBlockSize(format);
+}
+
+const char* GetCompressedFormatName(GLenum format)
+{
+	const FormatInfo* info = FindFormat(format);
+	return info != NULL ? info->name : "unknown";
+}
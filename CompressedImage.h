@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+// Block-compressed image with its mip chain, as stored in a .ktx2 or .dds file
+//
+// Readable formats: BC1, BC3 and BC7 (KTX2 and DDS), ETC2 RGB/RGBA (KTX2 only), each in UNORM or sRGB.
+// Supercompressed KTX2 (Basis, zstd) is not supported.
+//
+// GL wants the rows bottom-up, like the JPEG path's. DDS files are always top-down, and KTX2 files are too
+// unless KTXorientation says "ru" (toktx --lower_left_maps_to_s0t0). Top-down images are flipped as they
+// load by reversing the block rows and the rows inside each block. BC7 blocks, ETC2 planar blocks and
+// ETC2 sub-block pairs whose colors don't fit once swapped can't be flipped that way, so those files are
+// rejected. A level whose height isn't a multiple of 4 can't be flipped exactly either: its texels end
+// up shifted by the padding rows of the last block row (at most 3 texels of that level).
+struct CompressedLevel
+{
+	size_t offset, size; // into CompressedImage::data
+	int width, height;
+};
+
+struct CompressedImage
+{
+	GLenum format; // GL_COMPRESSED_*, 0 when empty
+	int width, height;
+	std::vector<CompressedLevel> levels; // level 0 is the full size
+	std::vector<unsigned char> data;
+	bool topDown; // rows start at the top; always false once loaded
+};
+
+enum CompressedContainer
+{
+	CONTAINER_KTX2,
+	CONTAINER_DDS
+};
+
+// By extension: .ktx2 or .dds
+bool IsCompressedImageFile(const char* fileLocation);
+
+// Reads the whole file; false (with a message) on anything unsupported or truncated
+bool LoadCompressedImage(const char* fileLocation, CompressedImage& image);
+
+// Reads only the header, for deciding whether the driver can use the file; 0 if unreadable or stored
+// top-down in a format that can't be flipped
+GLenum PeekCompressedFormat(const char* fileLocation);
+
+// KTX2 keeps the image's row order (written into KTXorientation). DDS readers expect top-down rows, so
+// bottom-up data is flipped on the way out, which fails for the formats that can't be flipped.
+bool SaveCompressedImage(const char* fileLocation, const CompressedImage& image, CompressedContainer container);
+
+// Bytes per 4x4 block (8 or 16), 0 for formats this file doesn't know
+size_t GetCompressedBlockSize(GLenum format);
+size_t GetCompressedLevelSize(GLenum format, int width, int height);
+const char* GetCompressedFormatName(GLenum format);
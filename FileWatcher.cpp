@@ -0,0 +1,133 @@
+#include "FileWatcher.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+FileWatcher::FileWatcher()
+{
+	notifyDescriptor = -1;
+	watchDescriptor = -1;
+}
+
+bool FileWatcher::Watch(const char* directory)
+{
+	watchedDirectory = directory;
+
+#ifdef __linux__
+	notifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (notifyDescriptor >= 0)
+	{
+		// Editors either rewrite the file in place or write a copy and rename it over the original
+		watchDescriptor = inotify_add_watch(notifyDescriptor, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watchDescriptor >= 0)
+		{
+			return true;
+		}
+
+		close(notifyDescriptor);
+		notifyDescriptor = -1;
+	}
+#endif
+
+	std::error_code error;
+	if (!std::filesystem::is_directory(watchedDirectory, error))
+	{
+		printf("Can't watch %s: not a directory\n", directory);
+		return false;
+	}
+
+	// First scan only records the current times
+	std::vector<std::string> ignored;
+	ScanDirectory(ignored);
+	nextScan = std::chrono::steady_clock::now();
+
+	return true;
+}
+
+std::vector<std::string> FileWatcher::PollChanges()
+{
+	std::vector<std::string> changes;
+
+#ifdef __linux__
+	if (notifyDescriptor >= 0)
+	{
+		alignas(struct inotify_event) char buffer[4096];
+
+		while (true)
+		{
+			ssize_t length = read(notifyDescriptor, buffer, sizeof(buffer));
+			if (length <= 0)
+			{
+				break; // EAGAIN: nothing more queued
+			}
+
+			for (char* entry = buffer; entry < buffer + length; )
+			{
+				struct inotify_event* event = (struct inotify_event*)entry;
+				if (event->len > 0)
+				{
+					changes.push_back(event->name);
+				}
+				entry += sizeof(struct inotify_event) + event->len;
+			}
+		}
+	}
+	else
+#endif
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (!watchedDirectory.empty() && now >= nextScan)
+		{
+			ScanDirectory(changes);
+			nextScan = now + std::chrono::milliseconds(500);
+		}
+	}
+
+	// One save can produce several events for the same file
+	std::sort(changes.begin(), changes.end());
+	changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+
+	return changes;
+}
+
+void FileWatcher::ScanDirectory(std::vector<std::string>& changes)
+{
+	std::error_code error;
+	for (std::filesystem::directory_iterator it(watchedDirectory, error), end; !error && it != end; it.increment(error))
+	{
+		if (!it->is_regular_file(error))
+		{
+			continue;
+		}
+
+		std::string name = it->path().filename().string();
+		std::filesystem::file_time_type writeTime = it->last_write_time(error);
+
+		std::unordered_map<std::string, std::filesystem::file_time_type>::iterator known = modificationTimes.find(name);
+		if (known == modificationTimes.end())
+		{
+			modificationTimes[name] = writeTime;
+		}
+		else if (known->second != writeTime)
+		{
+			known->second = writeTime;
+			changes.push_back(name);
+		}
+	}
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (notifyDescriptor >= 0)
+	{
+		close(notifyDescriptor);
+	}
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+
+// Reports files that change inside one directory (not its subdirectories)
+//
+// Uses inotify on Linux; elsewhere, or if inotify isn't available, it compares modification times,
+// at most twice a second, so calling PollChanges every frame stays cheap either way
+class FileWatcher
+{
+public:
+	FileWatcher();
+
+	bool Watch(const char* directory);
+
+	// Names (relative to the directory) of files written since the last call; never blocks
+	std::vector<std::string> PollChanges();
+
+	bool IsUsingNotifications() { return notifyDescriptor >= 0; }
+
+	~FileWatcher();
+
+private:
+	std::string watchedDirectory;
+	int notifyDescriptor, watchDescriptor;
+
+	// Modification-time fallback
+	std::unordered_map<std::string, std::filesystem::file_time_type> modificationTimes;
+	std::chrono::steady_clock::time_point nextScan;
+
+	void ScanDirectory(std::vector<std::string>& changes);
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+};
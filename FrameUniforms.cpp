@@ -0,0 +1,42 @@
+#include "FrameUniforms.h"
+
+FrameUniforms::FrameUniforms()
+{
+	UBO = 0;
+}
+
+void FrameUniforms::CreateBuffer()
+{
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PerFrameData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// The buffer stays attached to the binding point; programs find it through their block binding
+	glBindBufferBase(GL_UNIFORM_BUFFER, PER_FRAME_BINDING, UBO);
+}
+
+void FrameUniforms::Update(const PerFrameData& data)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+
+	// Orphan last frame's copy so the upload doesn't wait on draws still reading it
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(PerFrameData), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerFrameData), &data);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniforms::ClearBuffer()
+{
+	if (UBO != 0)
+	{
+		glDeleteBuffers(1, &UBO);
+		UBO = 0;
+	}
+}
+
+FrameUniforms::~FrameUniforms()
+{
+	ClearBuffer();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Binding point of the PerFrame uniform block, shared by every shader program
+const GLuint PER_FRAME_BINDING = 0;
+
+// Directional lights in the PerFrame block; shader variants sum the first LIGHT_COUNT of them
+const int MAX_LIGHTS = 16;
+
+// std140 mirror of the DirectionalLight struct in Shaders/PerFrame.glsl
+struct DirectionalLightData
+{
+	glm::vec3 color;
+	GLfloat ambientIntensity;
+	glm::vec3 direction;
+	GLfloat diffuseIntensity;
+};
+
+// std140 mirror of the PerFrame uniform block in Shaders/PerFrame.glsl
+struct PerFrameData
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 eyePosition;
+	GLfloat padding; // vec3 is aligned like a vec4 under std140
+	DirectionalLightData directionalLights[MAX_LIGHTS];
+};
+
+static_assert(sizeof(PerFrameData) == 144 + 32 * MAX_LIGHTS, "PerFrameData must match the std140 layout of the PerFrame block");
+
+// Uniform buffer holding the camera and light data for the frame, uploaded once no matter how many programs read it
+class FrameUniforms
+{
+public:
+	FrameUniforms();
+
+	void CreateBuffer();
+	void Update(const PerFrameData& data);
+	void ClearBuffer();
+
+	~FrameUniforms();
+
+private:
+	GLuint UBO;
+};
@@ -0,0 +1,80 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+Frustum::Frustum()
+{
+	// Until the first Extract, nothing is outside
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		planeX[i] = 0.0f;
+		planeY[i] = 0.0f;
+		planeZ[i] = 0.0f;
+		planeW[i] = 1.0f;
+	}
+}
+
+void Frustum::Extract(const glm::mat4& viewProjection)
+{
+	// GLM is column-major, so row r of the matrix is m[0][r], m[1][r], m[2][r], m[3][r]
+	const glm::mat4& m = viewProjection;
+
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		int row = i / 2;
+		GLfloat sign = (i % 2 == 0) ? 1.0f : -1.0f; // left/bottom/near add the row, right/top/far subtract it
+
+		GLfloat x = m[0][3] + sign * m[0][row];
+		GLfloat y = m[1][3] + sign * m[1][row];
+		GLfloat z = m[2][3] + sign * m[2][row];
+		GLfloat w = m[3][3] + sign * m[3][row];
+
+		// Normalized so the plane equation gives true distances, needed for the sphere radius
+		GLfloat length = sqrtf(x * x + y * y + z * z);
+		if (length > 0.0f)
+		{
+			x /= length;
+			y /= length;
+			z /= length;
+			w /= length;
+		}
+
+		planeX[i] = x;
+		planeY[i] = y;
+		planeZ[i] = z;
+		planeW[i] = w;
+	}
+}
+
+bool Frustum::IsSphereVisible(const glm::vec3& center, GLfloat radius) const
+{
+	// No early out, so the loop stays branch free
+	int outside = 0;
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		GLfloat distance = planeX[i] * center.x + planeY[i] * center.y + planeZ[i] * center.z + planeW[i];
+		outside |= (distance < -radius);
+	}
+
+	return outside == 0;
+}
+
+bool Frustum::IsBoxVisible(const glm::vec3& center, const glm::vec3& extents) const
+{
+	int outside = 0;
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		GLfloat distance = planeX[i] * center.x + planeY[i] * center.y + planeZ[i] * center.z + planeW[i];
+
+		// How far the box reaches towards the plane's normal
+		GLfloat reach = extents.x * fabsf(planeX[i]) + extents.y * fabsf(planeY[i]) + extents.z * fabsf(planeZ[i]);
+
+		outside |= (distance < -reach);
+	}
+
+	return outside == 0;
+}
+
+Frustum::~Frustum()
+{
+}
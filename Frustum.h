@@ -0,0 +1,32 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// View frustum as six world-space planes, used to skip draws the camera can't see
+//
+// Planes are stored as separate x/y/z/w arrays (structure of arrays) so each test is one
+// straight loop over the six planes that the compiler can vectorize
+class Frustum
+{
+public:
+	Frustum();
+
+	// Planes of projection * view (Gribb/Hartmann), normals pointing inward
+	void Extract(const glm::mat4& viewProjection);
+
+	bool IsSphereVisible(const glm::vec3& center, GLfloat radius) const;
+
+	// Axis-aligned box given by its center and half extents
+	bool IsBoxVisible(const glm::vec3& center, const glm::vec3& extents) const;
+
+	~Frustum();
+
+private:
+	static const int PLANE_COUNT = 6;
+
+	GLfloat planeX[PLANE_COUNT];
+	GLfloat planeY[PLANE_COUNT];
+	GLfloat planeZ[PLANE_COUNT];
+	GLfloat planeW[PLANE_COUNT];
+};
@@ -0,0 +1,166 @@
+#include "GLState.h"
+
+namespace
+{
+	// Never a valid name, so a cache entry holding it always misses
+	const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	// Units and targets past these are passed straight through
+	const GLuint TRACKED_UNITS = 16;
+	const GLenum TRACKED_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER };
+	const int TRACKED_TARGET_COUNT = sizeof(TRACKED_TARGETS) / sizeof(TRACKED_TARGETS[0]);
+
+	struct ContextState
+	{
+		GLuint vertexArray = UNKNOWN;
+		GLuint program = UNKNOWN;
+		GLuint activeUnit = UNKNOWN;
+		GLuint textures[TRACKED_UNITS][TRACKED_TARGET_COUNT];
+
+		unsigned long long issued = 0;
+		unsigned long long elided = 0;
+
+		ContextState()
+		{
+			ForgetTextures(UNKNOWN, true);
+		}
+
+		void ForgetTextures(GLuint texture, bool all)
+		{
+			for (GLuint unit = 0; unit < TRACKED_UNITS; unit++)
+			{
+				for (int target = 0; target < TRACKED_TARGET_COUNT; target++)
+				{
+					if (all || textures[unit][target] == texture)
+					{
+						textures[unit][target] = all ? UNKNOWN : 0;
+					}
+				}
+			}
+		}
+	};
+
+	thread_local ContextState state;
+
+	int GetTargetIndex(GLenum target)
+	{
+		for (int i = 0; i < TRACKED_TARGET_COUNT; i++)
+		{
+			if (TRACKED_TARGETS[i] == target)
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	}
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+	if (state.vertexArray == vertexArray)
+	{
+		state.elided++;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	state.vertexArray = vertexArray;
+	state.issued++;
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (state.program == program)
+	{
+		state.elided++;
+		return;
+	}
+
+	glUseProgram(program);
+	state.program = program;
+	state.issued++;
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int targetIndex = GetTargetIndex(target);
+	bool tracked = unit < TRACKED_UNITS && targetIndex >= 0;
+
+	if (tracked && state.textures[unit][targetIndex] == texture)
+	{
+		state.elided++;
+		return;
+	}
+
+	if (state.activeUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.activeUnit = unit;
+		state.issued++;
+	}
+
+	glBindTexture(target, texture);
+	if (tracked)
+	{
+		state.textures[unit][targetIndex] = texture;
+	}
+	state.issued++;
+}
+
+void GLState::ForgetVertexArray(GLuint vertexArray)
+{
+	if (state.vertexArray == vertexArray)
+	{
+		state.vertexArray = 0; // deleting the bound VAO binds 0
+	}
+}
+
+void GLState::ForgetProgram(GLuint program)
+{
+	// A deleted program stays in use, but its name can come back for a new one
+	if (state.program == program)
+	{
+		state.program = UNKNOWN;
+	}
+}
+
+void GLState::ForgetTexture(GLuint texture)
+{
+	state.ForgetTextures(texture, false); // deleting a bound texture binds 0 in its place
+}
+
+void GLState::Invalidate()
+{
+	state.vertexArray = UNKNOWN;
+	state.program = UNKNOWN;
+	state.activeUnit = UNKNOWN;
+	state.ForgetTextures(UNKNOWN, true);
+}
+
+unsigned long long GLState::GetIssuedCount()
+{
+	return state.issued;
+}
+
+unsigned long long GLState::GetElidedCount()
+{
+	return state.elided;
+}
+
+void GLState::ResetCounters()
+{
+	state.issued = 0;
+	state.elided = 0;
+}
+
+void GLState::PrintStats(unsigned int frames)
+{
+	if (frames == 0)
+	{
+		return;
+	}
+
+	printf("GL state: %.1f binds issued, %.1f redundant binds skipped per frame\n",
+		(double)state.issued / frames, (double)state.elided / frames);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <GL/glew.h>
+
+// Remembers what the calling thread's context has bound (VAO, program, active unit and the textures
+// on each unit) and skips GL calls that wouldn't change any of it
+//
+// Every bind of these goes through here, so the cache always matches the context. Deleting an object
+// unbinds it in GL (or, for a program, makes its name reusable), so the Forget functions must be
+// called alongside glDelete*. Code that binds behind the tracker's back calls Invalidate() after.
+// Each thread has its own state and counters, matching one context per thread.
+class GLState
+{
+public:
+	static void BindVertexArray(GLuint vertexArray);
+	static void UseProgram(GLuint program);
+
+	// Makes unit the active one if it isn't already, then binds texture to target on it
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	static void ForgetVertexArray(GLuint vertexArray);
+	static void ForgetProgram(GLuint program);
+	static void ForgetTexture(GLuint texture);
+
+	// Treats everything as unknown, so the next bind of each kind is always issued
+	static void Invalidate();
+
+	// Calls reaching GL / skipped as redundant on this thread since the last ResetCounters
+	static unsigned long long GetIssuedCount();
+	static unsigned long long GetElidedCount();
+	static void ResetCounters();
+
+	static void PrintStats(unsigned int frames);
+};
@@ -0,0 +1,205 @@
+#include "GeometryArena.h"
+
+#include <stdio.h>
+
+#include "GLState.h"
+
+GeometryArena::GeometryArena()
+{
+	layout = FLOAT_VERTEX_LAYOUT;
+	stride = 0;
+
+	VAO = 0;
+	VBO = 0;
+	IBO = 0;
+	vertexCapacity = 0;
+	indexCapacity = 0;
+	verticesUsed = 0;
+	indicesUsed = 0;
+	allocationCount = 0;
+}
+
+void GeometryArena::CreateArena(const VertexLayout& vertexLayout, GLuint vertices, GLuint indices)
+{
+	ClearArena();
+
+	layout = vertexLayout;
+	VertexAttribute attributes[3];
+	stride = GetVertexAttributes(layout, attributes);
+
+	glGenVertexArrays(1, &VAO);
+	GLState::BindVertexArray(VAO);
+
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)stride * vertices, NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &IBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indices, NULL, GL_STATIC_DRAW);
+
+	SetVertexAttributes(layout);
+
+	GLState::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	vertexCapacity = vertices;
+	indexCapacity = indices;
+	freeVertices.push_back({ 0, vertices });
+	freeIndices.push_back({ 0, indices });
+}
+
+bool GeometryArena::AllocateRange(std::vector<ArenaRange>& freeList, GLuint count, GLuint& offset)
+{
+	for (size_t i = 0; i < freeList.size(); i++)
+	{
+		if (freeList[i].count >= count)
+		{
+			offset = freeList[i].offset;
+			freeList[i].offset += count;
+			freeList[i].count -= count;
+
+			if (freeList[i].count == 0)
+			{
+				freeList.erase(freeList.begin() + i);
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void GeometryArena::FreeRange(std::vector<ArenaRange>& freeList, ArenaRange range)
+{
+	// Insert in offset order, then merge with whichever neighbours touch it
+	size_t i = 0;
+	while (i < freeList.size() && freeList[i].offset < range.offset)
+	{
+		i++;
+	}
+	freeList.insert(freeList.begin() + i, range);
+
+	if (i + 1 < freeList.size() && freeList[i].offset + freeList[i].count == freeList[i + 1].offset)
+	{
+		freeList[i].count += freeList[i + 1].count;
+		freeList.erase(freeList.begin() + i + 1);
+	}
+
+	if (i > 0 && freeList[i - 1].offset + freeList[i - 1].count == freeList[i].offset)
+	{
+		freeList[i - 1].count += freeList[i].count;
+		freeList.erase(freeList.begin() + i);
+	}
+}
+
+bool GeometryArena::Allocate(const void* vertices, GLuint vertexCount, const GLushort* indices, GLuint indexCount, GeometryAllocation& allocation)
+{
+	if (VAO == 0 || vertexCount == 0 || indexCount == 0)
+	{
+		return false;
+	}
+
+	allocation.vertices.count = vertexCount;
+	allocation.indices.count = indexCount;
+
+	if (!AllocateRange(freeVertices, vertexCount, allocation.vertices.offset))
+	{
+		return false;
+	}
+
+	if (!AllocateRange(freeIndices, indexCount, allocation.indices.offset))
+	{
+		FreeRange(freeVertices, allocation.vertices);
+		return false;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)stride * allocation.vertices.offset, (GLsizeiptr)stride * vertexCount, vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// The element binding is VAO state, so go through the arena's VAO rather than whichever is bound
+	GLState::BindVertexArray(VAO);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * allocation.indices.offset, sizeof(GLushort) * indexCount, indices);
+	GLState::BindVertexArray(0);
+
+	verticesUsed += vertexCount;
+	indicesUsed += indexCount;
+	allocationCount++;
+
+	return true;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation)
+{
+	if (VAO == 0)
+	{
+		return;
+	}
+
+	FreeRange(freeVertices, allocation.vertices);
+	FreeRange(freeIndices, allocation.indices);
+
+	verticesUsed -= allocation.vertices.count;
+	indicesUsed -= allocation.indices.count;
+	allocationCount--;
+}
+
+void GeometryArena::AttachBuffers()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	SetVertexAttributes(layout);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+}
+
+void GeometryArena::PrintStats()
+{
+	if (VAO == 0)
+	{
+		return;
+	}
+
+	printf("Geometry arena: %u meshes in %u of %u vertices and %u of %u indices (%.1f of %.1f KB), %zu free ranges\n",
+		allocationCount, verticesUsed, vertexCapacity, indicesUsed, indexCapacity,
+		((double)stride * verticesUsed + sizeof(GLushort) * indicesUsed) / 1024.0,
+		((double)stride * vertexCapacity + sizeof(GLushort) * indexCapacity) / 1024.0,
+		freeVertices.size() + freeIndices.size());
+}
+
+void GeometryArena::ClearArena()
+{
+	if (IBO != 0)
+	{
+		glDeleteBuffers(1, &IBO);
+		IBO = 0;
+	}
+
+	if (VBO != 0)
+	{
+		glDeleteBuffers(1, &VBO);
+		VBO = 0;
+	}
+
+	if (VAO != 0)
+	{
+		GLState::ForgetVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+
+	vertexCapacity = 0;
+	indexCapacity = 0;
+	verticesUsed = 0;
+	indicesUsed = 0;
+	allocationCount = 0;
+	freeVertices.clear();
+	freeIndices.clear();
+}
+
+GeometryArena::~GeometryArena()
+{
+	ClearArena();
+}
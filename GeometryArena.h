@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "VertexLayout.h"
+
+// A run of vertices or indices inside one of the arena's buffers
+struct ArenaRange
+{
+	GLuint offset;
+	GLuint count;
+};
+
+// Where a mesh lives inside a GeometryArena
+struct GeometryAllocation
+{
+	ArenaRange vertices;
+	ArenaRange indices;
+};
+
+// Static meshes of one vertex layout suballocated from a single VBO and IBO, so they all draw through
+// one VAO. Indices are 16-bit and relative to the mesh's first vertex (glDrawElementsBaseVertex adds
+// it back), so any mesh up to 65536 vertices fits wherever it lands in the arena.
+//
+// Each buffer keeps a first-fit free list sorted by offset; freed ranges merge with their neighbours.
+// The capacity is fixed when the arena is created, and meshes that don't fit keep their own buffers.
+class GeometryArena
+{
+public:
+	GeometryArena();
+
+	void CreateArena(const VertexLayout& layout, GLuint vertexCapacity, GLuint indexCapacity);
+
+	// Copies in vertices already encoded in the arena's layout; false when either buffer is too full
+	bool Allocate(const void* vertices, GLuint vertexCount, const GLushort* indices, GLuint indexCount, GeometryAllocation& allocation);
+	void Free(const GeometryAllocation& allocation);
+
+	// Points the bound VAO at the arena's buffers, for meshes that add their own instance attributes
+	void AttachBuffers();
+
+	GLuint GetVertexArray() { return VAO; }
+	const VertexLayout& GetVertexLayout() { return layout; }
+
+	void PrintStats();
+
+	void ClearArena();
+
+	~GeometryArena();
+
+private:
+	VertexLayout layout;
+	GLsizei stride;
+
+	GLuint VAO, VBO, IBO;
+	GLuint vertexCapacity, indexCapacity;
+	GLuint verticesUsed, indicesUsed;
+	unsigned int allocationCount;
+
+	std::vector<ArenaRange> freeVertices, freeIndices;
+
+	static bool AllocateRange(std::vector<ArenaRange>& freeList, GLuint count, GLuint& offset);
+	static void FreeRange(std::vector<ArenaRange>& freeList, ArenaRange range);
+};
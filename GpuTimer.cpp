@@ -0,0 +1,253 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+	enabled = false;
+	groupCount = 0;
+	reportInterval = 0;
+	frameSlot = 0;
+	framesCollected = 0;
+	framesDropped = 0;
+	activeGroup = -1;
+	frameSum = 0.0;
+	frameSamples = 0;
+	frameAverage = 0.0;
+
+	for (unsigned int i = 0; i < FRAME_LATENCY; i++)
+	{
+		frames[i].queriesUsed = 0;
+		frames[i].frameStart = 0;
+		frames[i].frameEnd = 0;
+		frames[i].issued = false;
+	}
+}
+
+GpuTimer::GpuTimer(const char** groupNames, unsigned int numGroups, unsigned int reportEveryFrames) : GpuTimer()
+{
+	enabled = true;
+	groupCount = numGroups;
+	reportInterval = reportEveryFrames;
+	names.assign(groupNames, groupNames + numGroups);
+
+	groupSums.assign(groupCount, 0.0);
+	frameGroupTimes.assign(groupCount, 0.0);
+	groupCounts.assign(groupCount, 0);
+	groupAverages.assign(groupCount, 0.0);
+	groupTimed.assign(groupCount, false);
+}
+
+void GpuTimer::CreateQueries()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < FRAME_LATENCY; i++)
+	{
+		// Start with one elapsed query per group; BeginGroup() adds more if a frame needs them
+		frames[i].queries.assign(groupCount, 0);
+		glGenQueries(groupCount, frames[i].queries.data());
+		frames[i].queryGroups.assign(groupCount, 0);
+		frames[i].queriesUsed = 0;
+		glGenQueries(1, &frames[i].frameStart);
+		glGenQueries(1, &frames[i].frameEnd);
+		frames[i].issued = false;
+	}
+}
+
+void GpuTimer::BeginFrame()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// This slot was last used FRAME_LATENCY frames ago - harvest it before reusing its queries
+	FrameQueries& frame = frames[frameSlot];
+	if (frame.issued)
+	{
+		CollectFrame(frame);
+	}
+
+	frame.queriesUsed = 0;
+	glQueryCounter(frame.frameStart, GL_TIMESTAMP);
+}
+
+void GpuTimer::BeginGroup(unsigned int group)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// GL_TIME_ELAPSED queries can't nest, so close whatever group is still open
+	if (activeGroup >= 0)
+	{
+		EndGroup();
+	}
+
+	FrameQueries& frame = frames[frameSlot];
+	if (frame.queriesUsed == frame.queries.size())
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+		frame.queryGroups.push_back(0);
+	}
+
+	frame.queryGroups[frame.queriesUsed] = group;
+	glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.queriesUsed]);
+	frame.queriesUsed++;
+	activeGroup = group;
+}
+
+void GpuTimer::EndGroup()
+{
+	if (!enabled || activeGroup < 0)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	activeGroup = -1;
+}
+
+void GpuTimer::EndFrame()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	EndGroup();
+
+	FrameQueries& frame = frames[frameSlot];
+	glQueryCounter(frame.frameEnd, GL_TIMESTAMP);
+	frame.issued = true;
+
+	frameSlot = (frameSlot + 1) % FRAME_LATENCY;
+}
+
+void GpuTimer::CollectFrame(FrameQueries& frame)
+{
+	frame.issued = false;
+
+	// Queries complete in order, so once the end timestamp is ready every query of the frame is
+	GLint available = 0;
+	glGetQueryObjectiv(frame.frameEnd, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		// Still in flight after FRAME_LATENCY frames - drop the sample rather than stall
+		framesDropped++;
+		return;
+	}
+
+	GLuint64 startTime = 0, endTime = 0;
+	glGetQueryObjectui64v(frame.frameStart, GL_QUERY_RESULT, &startTime);
+	glGetQueryObjectui64v(frame.frameEnd, GL_QUERY_RESULT, &endTime);
+	frameSum += (endTime - startTime) / 1000000.0;
+	frameSamples++;
+
+	std::fill(frameGroupTimes.begin(), frameGroupTimes.end(), -1.0);
+
+	for (unsigned int i = 0; i < frame.queriesUsed; i++)
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+
+		unsigned int group = frame.queryGroups[i];
+		frameGroupTimes[group] = (frameGroupTimes[group] < 0.0 ? 0.0 : frameGroupTimes[group]) + elapsed / 1000000.0;
+	}
+
+	// Averages are per frame, so a group entered several times counts once with its summed time
+	for (unsigned int group = 0; group < groupCount; group++)
+	{
+		if (frameGroupTimes[group] >= 0.0)
+		{
+			groupSums[group] += frameGroupTimes[group];
+			groupCounts[group]++;
+			groupTimed[group] = true;
+		}
+	}
+
+	framesCollected++;
+	if (reportInterval != 0 && framesCollected % reportInterval == 0)
+	{
+		FinishWindow();
+		PrintReport();
+	}
+}
+
+void GpuTimer::FinishWindow()
+{
+	for (unsigned int group = 0; group < groupCount; group++)
+	{
+		groupAverages[group] = groupCounts[group] ? groupSums[group] / groupCounts[group] : 0.0;
+		groupSums[group] = 0.0;
+		groupCounts[group] = 0;
+	}
+
+	frameAverage = frameSamples ? frameSum / frameSamples : 0.0;
+	frameSum = 0.0;
+	frameSamples = 0;
+}
+
+double GpuTimer::GetAverageMs(unsigned int group)
+{
+	if (!enabled || group >= groupCount)
+	{
+		return 0.0;
+	}
+
+	return groupAverages[group];
+}
+
+void GpuTimer::PrintReport()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// Fold in a partially filled window (e.g. when called at exit)
+	if (frameSamples != 0)
+	{
+		FinishWindow();
+	}
+
+	printf("GPU time (ms, per-frame average, %u/%u samples dropped): frame %.3f\n", framesDropped, framesCollected + framesDropped, frameAverage);
+
+	for (unsigned int group = 0; group < groupCount; group++)
+	{
+		if (groupTimed[group])
+		{
+			printf("  %-20s %8.3f\n", names[group], groupAverages[group]);
+		}
+	}
+}
+
+void GpuTimer::ClearQueries()
+{
+	for (unsigned int i = 0; i < FRAME_LATENCY; i++)
+	{
+		if (!frames[i].queries.empty())
+		{
+			glDeleteQueries((GLsizei)frames[i].queries.size(), frames[i].queries.data());
+			frames[i].queries.clear();
+			frames[i].queryGroups.clear();
+		}
+
+		if (frames[i].frameStart != 0)
+		{
+			glDeleteQueries(1, &frames[i].frameStart);
+			glDeleteQueries(1, &frames[i].frameEnd);
+			frames[i].frameStart = 0;
+			frames[i].frameEnd = 0;
+		}
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+}
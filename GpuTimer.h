@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+class GpuTimer
+{
+public:
+	GpuTimer(); // disabled - every call is a no-op
+
+	// Groups are indexed 0..numGroups-1; groups that never get timed are left out of the report
+	// A group may be entered several times per frame (e.g. after state sorting); its times are summed
+	GpuTimer(const char** groupNames, unsigned int numGroups, unsigned int reportEveryFrames);
+
+	bool IsEnabled() { return enabled; }
+
+	// Query objects need a current context, so they are created separately from the constructor
+	void CreateQueries();
+
+	void BeginFrame();
+	void BeginGroup(unsigned int group);
+	void EndGroup();
+	void EndFrame();
+
+	// Averages over the last completed report window (milliseconds)
+	double GetAverageMs(unsigned int group);
+	double GetAverageFrameMs() { return frameAverage; }
+
+	void PrintReport();
+
+	void ClearQueries();
+
+	~GpuTimer();
+
+private:
+	// Results are read back this many frames after they were issued, so reading never waits on the GPU
+	static const unsigned int FRAME_LATENCY = 4;
+
+	struct FrameQueries
+	{
+		std::vector<GLuint> queries;            // GL_TIME_ELAPSED pool, grows to the busiest frame
+		std::vector<unsigned int> queryGroups;  // group timed by each used query
+		unsigned int queriesUsed;
+		GLuint frameStart, frameEnd;            // GL_TIMESTAMP
+		bool issued;
+	};
+
+	bool enabled;
+	unsigned int groupCount, reportInterval;
+	std::vector<const char*> names;
+
+	FrameQueries frames[FRAME_LATENCY];
+	unsigned int frameSlot, framesCollected, framesDropped;
+	int activeGroup;
+
+	// Running sums for the current report window
+	std::vector<double> groupSums;
+	std::vector<double> frameGroupTimes;
+	std::vector<unsigned int> groupCounts;
+	double frameSum;
+	unsigned int frameSamples;
+
+	std::vector<double> groupAverages;
+	std::vector<bool> groupTimed;
+	double frameAverage;
+
+	void CollectFrame(FrameQueries& frame);
+	void FinishWindow();
+};
+
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+
+// 64-bit FNV-1a: simple and fast enough for cache keys, not for anything security related
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// Pass the previous result as `hash` to hash several pieces as one
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+// Same hash over the characters of a string, without the terminator; constexpr so literals can be
+// hashed by the compiler
+constexpr uint64_t HashString(std::string_view str, uint64_t hash = FNV_OFFSET_BASIS)
+{
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		hash ^= (unsigned char)str[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
@@ -18,13 +18,13 @@ Light::Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat ambIntensity, GLf
 	diffuseIntensity = difIntensity;
 }
 
-void Light::UseLight(GLfloat ambIntensityLocation, GLfloat ambColorLocation, GLfloat difIntensityLocation, GLfloat directionLocation)
+void Light::UseLight(DirectionalLightData& lightData)
 {
-	glUniform3f(ambColorLocation, color.x, color.y, color.z);
-	glUniform1f(ambIntensityLocation, ambientIntensity);
+	lightData.color = color;
+	lightData.ambientIntensity = ambientIntensity;
 
-	glUniform3f(directionLocation, direction.x, direction.y, direction.z);
-	glUniform1f(difIntensityLocation, diffuseIntensity);
+	lightData.direction = direction;
+	lightData.diffuseIntensity = diffuseIntensity;
 }
 
 Light::~Light()
@@ -1,14 +1,16 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include "FrameUniforms.h"
+
 class Light
 {
 public:
 	Light();
 	Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat ambIntensity, GLfloat xDir, GLfloat yDir, GLfloat zDir, GLfloat difIntensity);
 
-	// TODO: change types from GLfloat to GLuint (unsigned int in glew lib)
-	void UseLight(GLfloat ambIntensityLocation, GLfloat ambColorLocation, GLfloat difIntensityLocation, GLfloat directionLocation);
+	// Writes the light into the per-frame uniform block (see FrameUniforms)
+	void UseLight(DirectionalLightData& lightData);
 
 	~Light();
 
@@ -1,21 +1,29 @@
 #include "Material.h"
+#include "Shader.h"
+
+GLuint Material::nextMaterialID = 1;
 
 Material::Material() 
 {
 	specularIntensity = 0;
 	shininess = 0;
+	materialID = 0;
 }
 
 Material::Material(GLfloat specIntensity, GLfloat shine)
 {
 	specularIntensity = specIntensity;
 	shininess = shine;
+	materialID = nextMaterialID++;
 }
 
-void Material::UseMaterial(GLuint specularIntensityLocation, GLuint shininessLocation)
+void Material::UseMaterial(Shader* shader)
 {
-	glUniform1f(specularIntensityLocation, specularIntensity);
-	glUniform1f(shininessLocation, shininess);
+	constexpr uint64_t SPECULAR_INTENSITY = UniformName("material.specularIntensity");
+	constexpr uint64_t SHININESS = UniformName("material.shininess");
+
+	shader->Set(SPECULAR_INTENSITY, specularIntensity);
+	shader->Set(SHININESS, shininess);
 }
 
 Material::~Material() {}
\ No newline at end of file
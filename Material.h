@@ -1,5 +1,7 @@
 #include <GL/glew.h>
 
+class Shader;
+
 class Material
 {
 public:
@@ -7,12 +9,19 @@ public:
 
 	Material(GLfloat specIntensity, GLfloat shine);
 
-	void UseMaterial(GLuint specularIntensityLocation, GLuint shininessLocation);
+	// Sets the material uniforms of the shader, which must be in use
+	void UseMaterial(Shader* shader);
+
+	// Unique per material, used to sort draws that share a material
+	GLuint GetMaterialID() { return materialID; }
 
 	~Material();
 
 private:
 	GLfloat specularIntensity;
 	GLfloat shininess;
+
+	GLuint materialID;
+	static GLuint nextMaterialID;
 };
 
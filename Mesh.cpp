@@ -1,4 +1,11 @@
 #include "Mesh.h"
+#include "NormalMatrix.h"
+#include "GLState.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <glm/gtc/matrix_transform.hpp>
 
 Mesh::Mesh()
 {
@@ -6,53 +13,283 @@ Mesh::Mesh()
 	VBO = 0;
 	IBO = 0;
 	indexCount = 0;
+	indexType = GL_UNSIGNED_INT;
+	firstIndex = 0;
+	baseVertex = 0;
+
+	arena = NULL;
+	inArena = false;
+
+	layout = FLOAT_VERTEX_LAYOUT;
+	dequantization = glm::mat4(1.0f);
+	vertexBytes = 0;
+
+	boundsMin = glm::vec3(0.0f, 0.0f, 0.0f);
+	boundsMax = glm::vec3(0.0f, 0.0f, 0.0f);
+	boundingCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+	boundingRadius = 0.0f;
+
+	instanceVAO = 0;
+	instanceVBO = 0;
+	instanceCount = 0;
+	instanceCapacity = 0;
 }
 
-void Mesh::CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int numVerts, unsigned int numIndices)
+void Mesh::SetGeometryArena(GeometryArena* geometryArena)
+{
+	arena = geometryArena;
+}
+
+void Mesh::CreateMesh(const GLfloat *vertices, const unsigned int *indices, unsigned int numVerts, unsigned int numIndices,
+	const VertexLayout& vertexLayout)
 {
 	indexCount = numIndices;
 
+	CalculateBounds(vertices, numVerts);
+
+	layout = vertexLayout;
+	unsigned int vertexCount = numVerts / SOURCE_VERTEX_FLOATS;
+
+	// Normalized unsigned shorts can't hold tiling coordinates, so those meshes keep float UVs
+	if (layout.texCoord == TEXCOORD_UNORM16)
+	{
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			const GLfloat* uv = vertices + (size_t)i * SOURCE_VERTEX_FLOATS + 3;
+			if (uv[0] < 0.0f || uv[0] > 1.0f || uv[1] < 0.0f || uv[1] > 1.0f)
+			{
+				printf("Mesh tex coords leave [0, 1], keeping them as floats\n");
+				layout.texCoord = TEXCOORD_FLOAT;
+				break;
+			}
+		}
+	}
+
+	glm::vec3 halfExtent = (boundsMax - boundsMin) * 0.5f;
+	glm::vec3 boundsCenter = (boundsMin + boundsMax) * 0.5f;
+	dequantization = glm::mat4(1.0f);
+	if (layout.position == POSITION_SNORM16)
+	{
+		dequantization = glm::translate(dequantization, boundsCenter);
+		dequantization = glm::scale(dequantization, halfExtent);
+	}
+
+	// The float layout is the source format as is; anything else is re-encoded first
+	const void* vertexData = vertices;
+	std::vector<unsigned char> packed;
+	VertexAttribute attributes[3];
+	vertexBytes = (size_t)GetVertexAttributes(layout, attributes) * vertexCount;
+	if (layout != FLOAT_VERTEX_LAYOUT)
+	{
+		PackVertices(layout, vertices, vertexCount, boundsCenter, halfExtent, packed);
+		vertexData = packed.data();
+	}
+
+	// Half the index memory whenever the vertex count allows it. GL_UNSIGNED_BYTE would only save a few
+	// hundred more bytes on these meshes, and many drivers widen byte indices themselves
+	std::vector<GLushort> shortIndices;
+	indexType = GL_UNSIGNED_INT;
+	if (vertexCount <= 65536)
+	{
+		shortIndices.assign(indices, indices + numIndices);
+		indexType = GL_UNSIGNED_SHORT;
+	}
+
+	// Shared buffers when an arena of the same layout has room, otherwise this mesh's own
+	firstIndex = 0;
+	baseVertex = 0;
+	if (arena != NULL && layout == arena->GetVertexLayout() && indexType == GL_UNSIGNED_SHORT &&
+		arena->Allocate(vertexData, vertexCount, shortIndices.data(), numIndices, allocation))
+	{
+		inArena = true;
+		VAO = arena->GetVertexArray();
+		firstIndex = allocation.indices.offset;
+		baseVertex = (GLint)allocation.vertices.offset;
+		return;
+	}
+
+	if (arena != NULL)
+	{
+		printf("Mesh of %u vertices can't go in the geometry arena, giving it its own buffers\n", vertexCount);
+	}
+
 	// Create the VAO and bind it
 	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	GLState::BindVertexArray(VAO);
 
 	glGenBuffers(1, &IBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO); // Unbind this after unbinding the VAO further down
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numIndices, indices, GL_STATIC_DRAW);
+	if (indexType == GL_UNSIGNED_SHORT)
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * numIndices, shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numIndices, indices, GL_STATIC_DRAW);
+	}
 
 	// Create the VBO inside the VAO and bind it
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numVerts, vertices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
 
-	// Position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)0);
-	glEnableVertexAttribArray(0);
-	
-	// Texture coordinate attribute
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)sizeof(vertices[0] * 3));
-	glEnableVertexAttribArray(1);
-
-	// Normals attribute
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)sizeof(vertices[0] * 5));
-	glEnableVertexAttribArray(2);
+	// Position, tex coord and normal attributes at the layout's offsets
+	SetVertexAttributes(layout);
 
 	// Undo what you've done above by binding the VBO to 0 (nothing)
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::BindVertexArray(0);
+	// The IBO binding is part of the VAO's state, so it's only unbound once the VAO is
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+}
+
+void Mesh::CalculateBounds(const GLfloat *vertices, unsigned int numVerts)
+{
+	// Vertices are interleaved position, tex coord, normal
+	const unsigned int stride = SOURCE_VERTEX_FLOATS;
+
+	if (numVerts < stride)
+	{
+		return;
+	}
+
+	boundsMin = glm::vec3(vertices[0], vertices[1], vertices[2]);
+	boundsMax = boundsMin;
+
+	for (unsigned int i = stride; i + 2 < numVerts; i += stride)
+	{
+		glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+
+	// Sphere around the box center, sized to the farthest vertex rather than the box corner
+	boundingCenter = (boundsMin + boundsMax) * 0.5f;
+	boundingRadius = 0.0f;
+
+	for (unsigned int i = 0; i + 2 < numVerts; i += stride)
+	{
+		glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+		boundingRadius = glm::max(boundingRadius, glm::length(position - boundingCenter));
+	}
+}
+
+void Mesh::CreateMesh(const MeshData& data, const VertexLayout& vertexLayout)
+{
+	CreateMesh(data.vertices.data(), data.indices.data(), (unsigned int)data.vertices.size(), (unsigned int)data.indices.size(), vertexLayout);
 }
 
 void Mesh::RenderMesh()
 {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	// The IBO comes with the VAO, and the VAO stays bound for whatever draws next
+	GLState::BindVertexArray(VAO);
+	DrawMesh();
+}
 
-	// Unbind the VAO
-	glBindVertexArray(0);
-	// Unbind the IBO AFTER the VAO
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void Mesh::CreateInstanceBuffer()
+{
+	// The arena's VAO is shared, so instance attributes go on a VAO of this mesh's own over the same buffers
+	if (inArena)
+	{
+		glGenVertexArrays(1, &instanceVAO);
+		GLState::BindVertexArray(instanceVAO);
+		arena->AttachBuffers();
+	}
+	else
+	{
+		GLState::BindVertexArray(VAO);
+	}
+
+	glGenBuffers(1, &instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	// A mat4 attribute takes four consecutive locations, one vec4 column each
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribDivisor(3 + column, 1); // advance once per instance instead of once per vertex
+	}
+
+	// The mat3 normal matrix follows in three vec3 columns
+	for (GLuint column = 0; column < 3; column++)
+	{
+		glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, normalMatrix) + sizeof(glm::vec3) * column));
+		glEnableVertexAttribArray(7 + column);
+		glVertexAttribDivisor(7 + column, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::BindVertexArray(0);
+}
+
+void Mesh::UpdateInstances(const glm::mat4* transforms, GLsizei count)
+{
+	if (instanceVBO == 0)
+	{
+		CreateInstanceBuffer();
+	}
+
+	// Normal matrices are worked out here, once per instance, rather than per vertex in the shader
+	instanceData.resize(count);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		instanceData[i].model = transforms[i] * dequantization;
+		instanceData[i].normalMatrix = CalculateNormalMatrix(transforms[i]);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	// Grow geometrically so scenes that keep adding instances don't keep changing the buffer size
+	if (count > instanceCapacity)
+	{
+		instanceCapacity = count > instanceCapacity * 2 ? count : instanceCapacity * 2;
+	}
+
+	// Re-specifying the storage orphans the old copy, so the driver doesn't wait on draws still reading it
+	glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * instanceCapacity, NULL, GL_DYNAMIC_DRAW);
+
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * count, instanceData.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	instanceCount = count;
+}
+
+void Mesh::RenderMeshInstanced()
+{
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	GLState::BindVertexArray(GetVertexArray(true));
+	DrawMeshInstanced();
+}
+
+void Mesh::BindMesh()
+{
+	GLState::BindVertexArray(VAO);
+}
+
+GLuint Mesh::GetVertexArray(bool instanced)
+{
+	return instanced && instanceVAO != 0 ? instanceVAO : VAO;
+}
+
+void Mesh::DrawMesh()
+{
+	// First index and base vertex are both 0 unless the mesh lives in an arena
+	GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, (void*)(indexSize * firstIndex), baseVertex);
+}
+
+void Mesh::DrawMeshInstanced()
+{
+	if (instanceCount != 0)
+	{
+		GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, indexType, (void*)(indexSize * firstIndex), instanceCount, baseVertex);
+	}
 }
 
 void Mesh::ClearMesh()
@@ -70,13 +307,41 @@ void Mesh::ClearMesh()
 		VBO = 0;
 	}
 
+	if (instanceVBO != 0)
+	{
+		glDeleteBuffers(1, &instanceVBO);
+		instanceVBO = 0;
+	}
+
+	if (instanceVAO != 0)
+	{
+		GLState::ForgetVertexArray(instanceVAO);
+		glDeleteVertexArrays(1, &instanceVAO);
+		instanceVAO = 0;
+	}
+
+	// A mesh in an arena hands its ranges back; the arena owns the VAO and buffers
+	if (inArena)
+	{
+		arena->Free(allocation);
+		inArena = false;
+		VAO = 0;
+	}
+
 	if (VAO != 0)
 	{
+		GLState::ForgetVertexArray(VAO);
 		glDeleteVertexArrays(1, &VAO);
 		VAO = 0;
 	}
 
 	indexCount = 0;
+	firstIndex = 0;
+	baseVertex = 0;
+	indexType = GL_UNSIGNED_INT;
+	vertexBytes = 0;
+	instanceCount = 0;
+	instanceCapacity = 0;
 }
 
 Mesh::~Mesh()
@@ -1,12 +1,74 @@
+#include <vector>
+
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "VertexLayout.h"
+#include "GeometryArena.h"
+
+// CPU-side geometry (interleaved position, tex coord, normal) that can be built off the GL thread
+struct MeshData
+{
+	std::vector<GLfloat> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// Per-instance vertex attributes, interleaved in the instance buffer
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::mat3 normalMatrix;
+};
 
 class Mesh
 {
 public:
 	Mesh();
 
-	void CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int numVerts, unsigned int numIndices);
+	// Meshes created after this suballocate from the arena when it shares their layout (NULL for own buffers)
+	void SetGeometryArena(GeometryArena* geometryArena);
+
+	// Vertices always come in as MeshData-style floats; the layout decides how they're stored on the GPU
+	void CreateMesh(const GLfloat *vertices, const unsigned int *indices, unsigned int numVerts, unsigned int numIndices,
+		const VertexLayout& layout = FLOAT_VERTEX_LAYOUT);
+	void CreateMesh(const MeshData& data, const VertexLayout& layout = FLOAT_VERTEX_LAYOUT);
 	void RenderMesh();
+
+	// Split form of RenderMesh() for callers that track the bound mesh themselves
+	void BindMesh();
+	// What BindMesh binds, or for instanced draws the VAO that also carries the instance attributes
+	GLuint GetVertexArray(bool instanced);
+	void DrawMesh();
+	void DrawMeshInstanced();
+
+	GLuint GetMeshID() { return VAO; }
+
+	// Model-space bounds, computed from the positions in CreateMesh
+	glm::vec3 GetBoundsMin() { return boundsMin; }
+	glm::vec3 GetBoundsMax() { return boundsMax; }
+	glm::vec3 GetBoundingCenter() { return boundingCenter; }
+	GLfloat GetBoundingRadius() { return boundingRadius; }
+
+	// Maps the stored positions back to model space: identity unless they're quantized to the bounds.
+	// Whatever sets the model matrix multiplies this in on the right; normals need no such correction
+	const glm::mat4& GetDequantization() { return dequantization; }
+	const VertexLayout& GetVertexLayout() { return layout; }
+	size_t GetVertexBytes() { return vertexBytes; }
+
+	// Indices are stored as GL_UNSIGNED_SHORT when every vertex fits, GL_UNSIGNED_INT otherwise
+	GLenum GetIndexType() { return indexType; }
+	GLsizei GetIndexCount() { return indexCount; }
+	// Where DrawMesh starts in the bound buffers: both 0 unless the mesh lives in a geometry arena
+	GLuint GetFirstIndex() { return firstIndex; }
+	GLint GetBaseVertex() { return baseVertex; }
+	size_t GetIndexBytes() { return indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)); }
+
+	// Instanced path: one model matrix per instance, read from attribute locations 3-6, with its
+	// normal matrix computed here and read from locations 7-9
+	void UpdateInstances(const glm::mat4* transforms, GLsizei count);
+	GLsizei GetInstanceCount() { return instanceCount; }
+	void RenderMeshInstanced();
+
 	void ClearMesh();
 
 	~Mesh();
@@ -14,5 +76,26 @@ public:
 private:
 	GLuint VAO, VBO, IBO;
 	GLsizei indexCount;
+	GLenum indexType;
+	GLuint firstIndex;
+	GLint baseVertex;
+
+	GeometryArena* arena;
+	GeometryAllocation allocation;
+	bool inArena;
+
+	VertexLayout layout;
+	glm::mat4 dequantization;
+	size_t vertexBytes;
+
+	glm::vec3 boundsMin, boundsMax, boundingCenter;
+	GLfloat boundingRadius;
+
+	GLuint instanceVAO, instanceVBO;
+	GLsizei instanceCount, instanceCapacity;
+	std::vector<InstanceData> instanceData;
+
+	void CalculateBounds(const GLfloat *vertices, unsigned int numVerts);
+	void CreateInstanceBuffer();
 };
 
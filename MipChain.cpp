@@ -0,0 +1,179 @@
+#include "MipChain.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPCHAIN_SSE2 1
+#endif
+
+namespace
+{
+	// Average of up to four texels, rounded to nearest
+	void AverageTexel(const unsigned char* a, const unsigned char* b, const unsigned char* c, const unsigned char* d, unsigned char* out)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			out[channel] = (unsigned char)((a[channel] + b[channel] + c[channel] + d[channel] + 2) / 4);
+		}
+	}
+
+	// One destination row from two source rows, starting at destination texel x
+	void DownsampleRow(const unsigned char* row0, const unsigned char* row1, int nextWidth, int x, unsigned char* out)
+	{
+		for (; x < nextWidth; x++)
+		{
+			AverageTexel(row0 + x * 8, row0 + x * 8 + 4, row1 + x * 8, row1 + x * 8 + 4, out + x * 4);
+		}
+	}
+
+#ifdef MIPCHAIN_SSE2
+	// Four destination texels (eight source texels from each row) per iteration; returns where it stopped
+	int DownsampleRowSSE2(const unsigned char* row0, const unsigned char* row1, int nextWidth, unsigned char* out)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(2);
+
+		int x = 0;
+		for (; x + 4 <= nextWidth; x += 4)
+		{
+			__m128i top0 = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+			__m128i top1 = _mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16));
+			__m128i bottom0 = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+			__m128i bottom1 = _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16));
+
+			// Vertical sums in 16 bits, two source texels per register
+			__m128i sum01 = _mm_add_epi16(_mm_unpacklo_epi8(top0, zero), _mm_unpacklo_epi8(bottom0, zero));
+			__m128i sum23 = _mm_add_epi16(_mm_unpackhi_epi8(top0, zero), _mm_unpackhi_epi8(bottom0, zero));
+			__m128i sum45 = _mm_add_epi16(_mm_unpacklo_epi8(top1, zero), _mm_unpacklo_epi8(bottom1, zero));
+			__m128i sum67 = _mm_add_epi16(_mm_unpackhi_epi8(top1, zero), _mm_unpackhi_epi8(bottom1, zero));
+
+			// Horizontal pairs: add the upper texel onto the lower one, then keep the lower halves
+			sum01 = _mm_add_epi16(sum01, _mm_srli_si128(sum01, 8));
+			sum23 = _mm_add_epi16(sum23, _mm_srli_si128(sum23, 8));
+			sum45 = _mm_add_epi16(sum45, _mm_srli_si128(sum45, 8));
+			sum67 = _mm_add_epi16(sum67, _mm_srli_si128(sum67, 8));
+
+			__m128i texels01 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23), rounding), 2);
+			__m128i texels23 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum45, sum67), rounding), 2);
+
+			_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(texels01, texels23));
+		}
+
+		return x;
+	}
+#endif
+}
+
+void DownsampleRGBA8(const unsigned char* source, int width, int height, unsigned char* destination)
+{
+	int nextWidth = GetNextMipSize(width);
+	int nextHeight = GetNextMipSize(height);
+
+	// A one texel wide or high image only has one neighbour to average with
+	if (width == 1 || height == 1)
+	{
+		for (int i = 0; i < nextWidth * nextHeight; i++)
+		{
+			const unsigned char* first = source + (size_t)i * 8;
+			const unsigned char* second = (width == 1 && height == 1) ? first : first + 4;
+			AverageTexel(first, first, second, second, destination + (size_t)i * 4);
+		}
+		return;
+	}
+
+	for (int y = 0; y < nextHeight; y++)
+	{
+		const unsigned char* row0 = source + (size_t)(y * 2) * width * 4;
+		const unsigned char* row1 = row0 + (size_t)width * 4;
+		unsigned char* out = destination + (size_t)y * nextWidth * 4;
+
+		int x = 0;
+#ifdef MIPCHAIN_SSE2
+		x = DownsampleRowSSE2(row0, row1, nextWidth, out);
+#endif
+		DownsampleRow(row0, row1, nextWidth, x, out);
+	}
+}
+
+void ResampleRGBA8(const unsigned char* source, int width, int height, unsigned char* destination, int newWidth, int newHeight)
+{
+	std::vector<unsigned char> halved;
+	while (width >= newWidth * 2 && height >= newHeight * 2)
+	{
+		std::vector<unsigned char> next((size_t)GetNextMipSize(width) * GetNextMipSize(height) * 4);
+		DownsampleRGBA8(source, width, height, next.data());
+		halved.swap(next);
+		source = halved.data();
+		width = GetNextMipSize(width);
+		height = GetNextMipSize(height);
+	}
+
+	// Texel centers line up: destination x + 0.5 maps to source (x + 0.5) * width / newWidth
+	float scaleX = (float)width / newWidth;
+	float scaleY = (float)height / newHeight;
+
+	for (int y = 0; y < newHeight; y++)
+	{
+		float sourceY = (y + 0.5f) * scaleY - 0.5f;
+		sourceY = sourceY < 0.0f ? 0.0f : sourceY;
+		int y0 = (int)sourceY;
+		int y1 = y0 + 1 < height ? y0 + 1 : height - 1;
+		float weightY = sourceY - y0;
+
+		for (int x = 0; x < newWidth; x++)
+		{
+			float sourceX = (x + 0.5f) * scaleX - 0.5f;
+			sourceX = sourceX < 0.0f ? 0.0f : sourceX;
+			int x0 = (int)sourceX;
+			int x1 = x0 + 1 < width ? x0 + 1 : width - 1;
+			float weightX = sourceX - x0;
+
+			const unsigned char* a = source + ((size_t)y0 * width + x0) * 4;
+			const unsigned char* b = source + ((size_t)y0 * width + x1) * 4;
+			const unsigned char* c = source + ((size_t)y1 * width + x0) * 4;
+			const unsigned char* d = source + ((size_t)y1 * width + x1) * 4;
+			unsigned char* out = destination + ((size_t)y * newWidth + x) * 4;
+
+			for (int channel = 0; channel < 4; channel++)
+			{
+				float top = a[channel] + (b[channel] - a[channel]) * weightX;
+				float bottom = c[channel] + (d[channel] - c[channel]) * weightX;
+				out[channel] = (unsigned char)(top + (bottom - top) * weightY + 0.5f);
+			}
+		}
+	}
+}
+
+void BuildMipChain(const unsigned char* rgba, int width, int height, MipChain& chain)
+{
+	chain.levels.clear();
+	chain.data.clear();
+
+	// Sizes first, so the buffer is allocated once
+	size_t total = 0;
+	for (int levelWidth = width, levelHeight = height; levelWidth > 1 || levelHeight > 1;)
+	{
+		levelWidth = GetNextMipSize(levelWidth);
+		levelHeight = GetNextMipSize(levelHeight);
+
+		MipLevel level;
+		level.offset = total;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		chain.levels.push_back(level);
+
+		total += (size_t)levelWidth * levelHeight * 4;
+	}
+	chain.data.resize(total);
+
+	const unsigned char* source = rgba;
+	int sourceWidth = width, sourceHeight = height;
+	for (size_t i = 0; i < chain.levels.size(); i++)
+	{
+		unsigned char* destination = &chain.data[chain.levels[i].offset];
+		DownsampleRGBA8(source, sourceWidth, sourceHeight, destination);
+
+		source = destination;
+		sourceWidth = chain.levels[i].width;
+		sourceHeight = chain.levels[i].height;
+	}
+}
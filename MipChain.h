@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// Mip levels of an RGBA8 image built on the CPU, so a decode worker can do what glGenerateMipmap
+// would otherwise do on the GL thread
+//
+// Plain 2x2 box filter with sizes rounded down (an odd last row or column is dropped), which is
+// what drivers use for glGenerateMipmap, so textures look the same whichever side builds the chain.
+// Uses SSE2 where the compiler targets it.
+
+// Size of the level below: halved, rounded down, never below 1
+inline int GetNextMipSize(int size)
+{
+	return size > 1 ? size / 2 : 1;
+}
+
+// Writes the next level of source into destination (GetNextMipSize of each side)
+void DownsampleRGBA8(const unsigned char* source, int width, int height, unsigned char* destination);
+
+// Any size to any other: halves with the box filter while the source is at least twice the
+// destination on both sides, then finishes with a bilinear pass, so big reductions don't alias
+void ResampleRGBA8(const unsigned char* source, int width, int height, unsigned char* destination, int newWidth, int newHeight);
+
+struct MipLevel
+{
+	size_t offset; // into MipChain::data
+	int width, height;
+};
+
+// Every level below the full-size image, down to 1x1; level 0 stays with the caller
+struct MipChain
+{
+	std::vector<MipLevel> levels; // levels[0] is mip level 1
+	std::vector<unsigned char> data;
+};
+
+// Bytes the levels take, also once data has been moved elsewhere
+inline size_t GetMipChainSize(const MipChain& chain)
+{
+	if (chain.levels.empty())
+	{
+		return 0;
+	}
+
+	const MipLevel& last = chain.levels.back();
+	return last.offset + (size_t)last.width * last.height * 4;
+}
+
+void BuildMipChain(const unsigned char* rgba, int width, int height, MipChain& chain);
@@ -0,0 +1,41 @@
+#include "NormalMatrix.h"
+
+#include <cmath>
+
+bool IsUniformScale(const glm::mat3& linear)
+{
+	GLfloat xx = glm::dot(linear[0], linear[0]);
+	GLfloat yy = glm::dot(linear[1], linear[1]);
+	GLfloat zz = glm::dot(linear[2], linear[2]);
+
+	// Relative to the squared scale so large and small transforms are judged the same
+	GLfloat tolerance = 1e-4f * xx;
+
+	return fabsf(xx - yy) <= tolerance && fabsf(xx - zz) <= tolerance &&
+		fabsf(glm::dot(linear[0], linear[1])) <= tolerance &&
+		fabsf(glm::dot(linear[0], linear[2])) <= tolerance &&
+		fabsf(glm::dot(linear[1], linear[2])) <= tolerance;
+}
+
+glm::mat3 CalculateNormalMatrix(const glm::mat4& model)
+{
+	glm::mat3 linear = glm::mat3(model);
+
+	if (IsUniformScale(linear))
+	{
+		return linear;
+	}
+
+	glm::mat3 cofactor = glm::mat3(
+		glm::cross(linear[1], linear[2]),
+		glm::cross(linear[2], linear[0]),
+		glm::cross(linear[0], linear[1]));
+
+	// A mirroring transform has a negative determinant, which would flip the normals inward
+	if (glm::dot(linear[0], cofactor[0]) < 0.0f)
+	{
+		cofactor = -cofactor;
+	}
+
+	return cofactor;
+}
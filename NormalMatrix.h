@@ -0,0 +1,14 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// True when the upper 3x3 is a rotation times one scale factor (no shear, no per-axis scale)
+bool IsUniformScale(const glm::mat3& linear);
+
+// Matrix that carries normals through the model transform, computed once per draw instead of per vertex
+//
+// The shaders renormalize, so only the direction matters: uniform-scale transforms use their upper 3x3
+// directly, anything else uses the cofactor matrix (the inverse transpose scaled by the determinant),
+// which needs no division and stays finite for transforms that flatten an axis
+glm::mat3 CalculateNormalMatrix(const glm::mat4& model);
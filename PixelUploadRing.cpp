@@ -0,0 +1,241 @@
+#include "PixelUploadRing.h"
+#include "Profiler.h"
+
+namespace
+{
+	// Keeps every region's start cache-line and texel aligned
+	const size_t REGION_ALIGNMENT = 256;
+}
+
+PixelUploadRing::PixelUploadRing()
+{
+	bufferID = 0;
+	mapped = NULL;
+	capacity = 0;
+	head = 0;
+	allocations = 0;
+	fallbacks = 0;
+	peakUsed = 0;
+}
+
+bool PixelUploadRing::CreateRing(size_t capacity)
+{
+	if (!GLEW_ARB_buffer_storage || capacity == 0 || bufferID != 0)
+	{
+		return false;
+	}
+
+	this->capacity = capacity;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, bufferID);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)capacity, NULL, flags);
+
+	// Coherent, so what a worker writes is visible to any upload issued after it
+	mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)capacity, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (mapped == NULL)
+	{
+		printf("Failed to map the %.0f MB texture upload ring\n", capacity / (1024.0 * 1024.0));
+		glDeleteBuffers(1, &bufferID);
+		bufferID = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void PixelUploadRing::PopFreeRegions()
+{
+	while (!regions.empty() && regions.front().state == REGION_FREE)
+	{
+		regions.pop_front();
+	}
+}
+
+// Called with the lock held
+bool PixelUploadRing::FindSpace(size_t size, size_t& offset)
+{
+	if (regions.empty())
+	{
+		head = 0;
+		offset = 0;
+		return size <= capacity;
+	}
+
+	size_t tail = regions.front().offset;
+
+	// Live regions are [tail, head): room after head, else wrap to the start
+	if (head > tail)
+	{
+		if (capacity - head >= size)
+		{
+			offset = head;
+			return true;
+		}
+
+		if (tail >= size)
+		{
+			if (head < capacity)
+			{
+				Region padding = { head, capacity - head, REGION_FREE, 0 };
+				regions.push_back(padding);
+			}
+
+			offset = 0;
+			return true;
+		}
+
+		return false;
+	}
+
+	// Wrapped: live regions are [tail, capacity) and [0, head), the gap in between is free
+	if (tail - head >= size)
+	{
+		offset = head;
+		return true;
+	}
+
+	return false;
+}
+
+bool PixelUploadRing::Allocate(size_t size, Allocation& allocation)
+{
+	allocation.offset = 0;
+	allocation.size = 0;
+	allocation.data = NULL;
+
+	if (mapped == NULL)
+	{
+		return false;
+	}
+
+	size_t alignedSize = (size + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+
+	std::lock_guard<std::mutex> lock(regionMutex);
+
+	PopFreeRegions();
+
+	size_t offset = 0;
+	if (!FindSpace(alignedSize, offset))
+	{
+		fallbacks++;
+		return false;
+	}
+
+	Region region = { offset, alignedSize, REGION_WRITING, 0 };
+	regions.push_back(region);
+	head = offset + alignedSize;
+	allocations++;
+
+	size_t used = head > regions.front().offset ? head - regions.front().offset : capacity - regions.front().offset + head;
+	peakUsed = used > peakUsed ? used : peakUsed;
+
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.data = mapped + offset;
+	return true;
+}
+
+void PixelUploadRing::Release(const Allocation& allocation, bool fenced)
+{
+	if (allocation.data == NULL)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(regionMutex);
+
+		for (size_t i = 0; i < regions.size(); i++)
+		{
+			if (regions[i].offset == allocation.offset && regions[i].state == REGION_WRITING)
+			{
+				regions[i].state = fenced ? REGION_FENCED : REGION_FREE;
+				regions[i].fence = fenced ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : 0;
+				break;
+			}
+		}
+	}
+
+	if (fenced)
+	{
+		Retire();
+	}
+}
+
+void PixelUploadRing::Retire()
+{
+	std::lock_guard<std::mutex> lock(regionMutex);
+
+	while (!regions.empty())
+	{
+		Region& region = regions.front();
+
+		if (region.state == REGION_FENCED)
+		{
+			// Zero timeout: only asks, never blocks the frame
+			GLenum status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			{
+				break;
+			}
+
+			glDeleteSync(region.fence);
+			region.state = REGION_FREE;
+		}
+
+		if (region.state != REGION_FREE)
+		{
+			break;
+		}
+
+		regions.pop_front();
+	}
+}
+
+void PixelUploadRing::PrintStats()
+{
+	if (mapped == NULL)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(regionMutex);
+	printf("Texture upload ring: %u uploads streamed, %u fell back to client memory, peak %.1f of %.1f MB\n",
+		allocations, fallbacks, peakUsed / (1024.0 * 1024.0), capacity / (1024.0 * 1024.0));
+}
+
+void PixelUploadRing::ClearRing()
+{
+	std::lock_guard<std::mutex> lock(regionMutex);
+
+	for (size_t i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].fence != 0)
+		{
+			glDeleteSync(regions[i].fence);
+		}
+	}
+	regions.clear();
+
+	if (bufferID != 0)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, bufferID);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &bufferID);
+	}
+
+	bufferID = 0;
+	mapped = NULL;
+	head = 0;
+}
+
+PixelUploadRing::~PixelUploadRing()
+{
+	ClearRing();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+
+#include <GL/glew.h>
+
+// A ring of persistently mapped GL_PIXEL_UNPACK_BUFFER memory that decoded textures stream through
+//
+// Decode workers Allocate() a region and copy their pixels straight into the mapping. The GL thread
+// uploads from it (with the buffer bound, glTexSubImage2D's pointer is an offset into it) and calls
+// Release(), which fences the region; Retire() reuses it once the GPU has finished reading. Regions are
+// reused in allocation order. A full ring makes Allocate() fail rather than wait, and the texture then
+// uploads from its own memory as before. Needs GL_ARB_buffer_storage (GL 4.4).
+class PixelUploadRing
+{
+public:
+	struct Allocation
+	{
+		size_t offset; // into the buffer, what the upload calls take as their pointer
+		size_t size;
+		unsigned char* data; // mapped, write only; NULL when empty
+	};
+
+	PixelUploadRing();
+
+	// GL thread; false (and the ring stays unused) without GL_ARB_buffer_storage
+	bool CreateRing(size_t capacity);
+
+	// Any thread; false when the ring has no room for size bytes right now
+	bool Allocate(size_t size, Allocation& allocation);
+
+	// GL thread, after every upload reading the region was issued. An allocation nothing read
+	// (fenced false) is freed straight away, from any thread.
+	void Release(const Allocation& allocation, bool fenced);
+
+	// GL thread, once a frame: frees regions whose uploads the GPU has finished, without waiting
+	void Retire();
+
+	bool IsCreated() { return bufferID != 0; }
+	GLuint GetBufferID() { return bufferID; }
+
+	void PrintStats();
+
+	void ClearRing();
+
+	~PixelUploadRing();
+
+private:
+	enum RegionState
+	{
+		REGION_WRITING, // allocated, not uploaded yet
+		REGION_FENCED,  // uploaded, the GPU may still be reading
+		REGION_FREE     // done, or padding skipped at the end of the buffer
+	};
+
+	struct Region
+	{
+		size_t offset, size;
+		RegionState state;
+		GLsync fence;
+	};
+
+	GLuint bufferID;
+	unsigned char* mapped;
+	size_t capacity;
+	size_t head; // where the next allocation goes
+
+	// Oldest first; the first one's offset is the tail of the ring
+	std::deque<Region> regions;
+	std::mutex regionMutex;
+
+	unsigned int allocations, fallbacks;
+	size_t peakUsed;
+
+	bool FindSpace(size_t size, size_t& offset);
+	void PopFreeRegions();
+
+	PixelUploadRing(const PixelUploadRing&) = delete;
+	PixelUploadRing& operator=(const PixelUploadRing&) = delete;
+};
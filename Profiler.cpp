@@ -0,0 +1,172 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct ZoneEvent
+	{
+		const char* name;
+		long long start, end;
+	};
+
+	struct ThreadBuffer
+	{
+		unsigned int threadIndex;
+		const char* threadName;
+		std::vector<ZoneEvent> events;
+	};
+
+	// Buffers are owned here rather than by the thread so they outlive worker threads
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+	thread_local ThreadBuffer* localBuffer = NULL;
+
+	ThreadBuffer* GetThreadBuffer()
+	{
+		if (localBuffer == NULL)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+
+			registry.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+			localBuffer = registry.back().get();
+			localBuffer->threadIndex = (unsigned int)registry.size();
+			localBuffer->threadName = NULL;
+			localBuffer->events.reserve(1 << 16);
+		}
+
+		return localBuffer;
+	}
+}
+
+bool Profiler::enabled = false;
+double Profiler::zoneCost = 0.0;
+
+void Profiler::SetEnabled(bool enable)
+{
+	enabled = enable;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	GetThreadBuffer()->threadName = name;
+}
+
+long long Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Record(const char* name, long long start, long long end)
+{
+	ZoneEvent zoneEvent = { name, start, end };
+	GetThreadBuffer()->events.push_back(zoneEvent);
+}
+
+double Profiler::MeasureZoneCost()
+{
+	const int iterations = 100000;
+
+	bool wasEnabled = enabled;
+	enabled = true;
+
+	ThreadBuffer* buffer = GetThreadBuffer();
+	size_t eventCount = buffer->events.size();
+
+	long long begin = Now();
+	for (int i = 0; i < iterations; i++)
+	{
+		PROFILE_ZONE("calibration");
+	}
+	long long end = Now();
+
+	// Calibration zones aren't part of the trace
+	buffer->events.resize(eventCount);
+	enabled = wasEnabled;
+
+	zoneCost = (double)(end - begin) / iterations;
+	return zoneCost;
+}
+
+void Profiler::PrintOverhead(unsigned int frames, double seconds)
+{
+	if (frames == 0 || seconds <= 0.0)
+	{
+		return;
+	}
+
+	size_t zoneCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (size_t i = 0; i < registry.size(); i++)
+		{
+			zoneCount += registry[i]->events.size();
+		}
+	}
+
+	double zonesPerFrame = (double)zoneCount / frames;
+	double frameNs = seconds * 1e9 / frames;
+	double overheadNs = zonesPerFrame * zoneCost;
+
+	printf("Profiler: %.1f zones/frame at %.1f ns each = %.2f us/frame (%.3f%% of a %.3f ms frame)\n",
+		zonesPerFrame, zoneCost, overheadNs / 1000.0, 100.0 * overheadNs / frameNs, frameNs / 1e6);
+}
+
+bool Profiler::WriteChromeTrace(const char* fileLocation)
+{
+	FILE* file = fopen(fileLocation, "w");
+	if (!file)
+	{
+		printf("Failed to write %s!\n", fileLocation);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	// Trace timestamps are microseconds relative to the earliest zone
+	long long origin = 0;
+	for (size_t i = 0; i < registry.size(); i++)
+	{
+		for (size_t j = 0; j < registry[i]->events.size(); j++)
+		{
+			long long start = registry[i]->events[j].start;
+			if (origin == 0 || start < origin)
+			{
+				origin = start;
+			}
+		}
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool first = true;
+	for (size_t i = 0; i < registry.size(); i++)
+	{
+		ThreadBuffer* buffer = registry[i].get();
+
+		if (buffer->threadName != NULL)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", buffer->threadIndex, buffer->threadName);
+			first = false;
+		}
+
+		for (size_t j = 0; j < buffer->events.size(); j++)
+		{
+			const ZoneEvent& zoneEvent = buffer->events[j];
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",\n", zoneEvent.name, buffer->threadIndex,
+				(zoneEvent.start - origin) / 1000.0, (zoneEvent.end - zoneEvent.start) / 1000.0);
+			first = false;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdio.h>
+
+// Scoped CPU zones, written out as a chrome://tracing / Perfetto JSON trace
+//
+// Each zone reads the clock once on entry and once on exit and appends a single event to a
+// buffer owned by the calling thread, so threads never contend while recording.
+// Zone names must be string literals (only the pointer is stored).
+class Profiler
+{
+public:
+	static void SetEnabled(bool enable);
+	static bool IsEnabled() { return enabled; }
+
+	// Label the calling thread in the trace
+	static void SetThreadName(const char* name);
+
+	static long long Now(); // nanoseconds
+	static void Record(const char* name, long long start, long long end);
+
+	// Times a batch of empty zones and returns the cost of one zone in nanoseconds
+	static double MeasureZoneCost();
+
+	// Prints zones per frame and their estimated share of the frame time
+	static void PrintOverhead(unsigned int frames, double seconds);
+
+	// Reads every thread's events without locking them, so no other thread may be recording zones
+	static bool WriteChromeTrace(const char* fileLocation);
+
+private:
+	static bool enabled;
+	static double zoneCost;
+};
+
+class ProfileZone
+{
+public:
+	ProfileZone(const char* zoneName)
+	{
+		name = zoneName;
+		start = Profiler::IsEnabled() ? Profiler::Now() : 0;
+	}
+
+	~ProfileZone()
+	{
+		if (start != 0)
+		{
+			Profiler::Record(name, start, Profiler::Now());
+		}
+	}
+
+private:
+	const char* name;
+	long long start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
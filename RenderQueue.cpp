@@ -0,0 +1,262 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "Texture.h"
+#include "Material.h"
+#include "GpuTimer.h"
+#include "NormalMatrix.h"
+#include "Frustum.h"
+#include "StaticBatch.h"
+#include "GLState.h"
+
+RenderQueue::RenderQueue()
+{
+	gpuTimer = NULL;
+	frustum = NULL;
+	stateChanges = 0;
+	stateChangesAvoided = 0;
+	culledCount = 0;
+	visibleCount = 0;
+	totalDraws = 0;
+	totalVisible = 0;
+	totalStateChanges = 0;
+	totalAvoided = 0;
+	totalCulled = 0;
+	framesFlushed = 0;
+}
+
+void RenderQueue::Begin()
+{
+	items.clear();
+	culledCount = 0;
+	visibleCount = 0;
+}
+
+void RenderQueue::Submit(Shader* shader, Mesh* mesh, Texture* texture, Material* material, const glm::mat4& transform, int group)
+{
+	if (frustum != NULL && !IsVisible(mesh, transform))
+	{
+		culledCount++;
+		return;
+	}
+
+	visibleCount++;
+	AddItem(shader, mesh, texture, material, transform, false, group);
+}
+
+void RenderQueue::SubmitInstanced(Shader* shader, Mesh* mesh, Texture* texture, Material* material, int group)
+{
+	visibleCount += mesh->GetInstanceCount();
+	AddItem(shader, mesh, texture, material, glm::mat4(1.0f), true, group);
+}
+
+void RenderQueue::SubmitBatch(Shader* shader, StaticBatch* batch, Texture* texture, Material* material, int group)
+{
+	visibleCount += batch->GetObjectCount();
+
+	RenderItem item;
+	item.shader = shader;
+	item.mesh = NULL;
+	item.batch = batch;
+	item.texture = texture;
+	item.material = material;
+	item.transform = glm::mat4(1.0f);
+	item.normalMatrix = glm::mat3(1.0f);
+	item.instanced = false;
+	item.group = group;
+	item.sortKey = MakeSortKey(shader, texture, material, batch->GetVertexArray());
+
+	items.push_back(item);
+}
+
+bool RenderQueue::IsVisible(Mesh* mesh, const glm::mat4& transform)
+{
+	// Bounding sphere first: the center moves with the transform and the radius grows with its largest axis scale
+	glm::vec3 center = glm::vec3(transform * glm::vec4(mesh->GetBoundingCenter(), 1.0f));
+	GLfloat scaleSquared = glm::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+		glm::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+
+	if (!frustum->IsSphereVisible(center, mesh->GetBoundingRadius() * sqrtf(scaleSquared)))
+	{
+		return false;
+	}
+
+	// Then the tighter world-space box enclosing the transformed AABB (same center as the sphere)
+	glm::vec3 localExtents = (mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f;
+	glm::vec3 extents;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		extents[axis] = fabsf(transform[0][axis]) * localExtents.x +
+			fabsf(transform[1][axis]) * localExtents.y +
+			fabsf(transform[2][axis]) * localExtents.z;
+	}
+
+	return frustum->IsBoxVisible(center, extents);
+}
+
+void RenderQueue::AddItem(Shader* shader, Mesh* mesh, Texture* texture, Material* material, const glm::mat4& transform, bool instanced, int group)
+{
+	RenderItem item;
+	item.shader = shader;
+	item.mesh = mesh;
+	item.batch = NULL;
+	item.texture = texture;
+	item.material = material;
+	// Quantized positions are taken back to model space before the object transform applies
+	item.transform = transform * mesh->GetDequantization();
+	item.normalMatrix = instanced ? glm::mat3(1.0f) : CalculateNormalMatrix(transform); // instances carry their own
+	item.instanced = instanced;
+	item.group = group;
+
+	item.sortKey = MakeSortKey(shader, texture, material, mesh->GetVertexArray(instanced));
+
+	items.push_back(item);
+}
+
+unsigned long long RenderQueue::MakeSortKey(Shader* shader, Texture* texture, Material* material, GLuint vertexArray)
+{
+	// Most expensive state change in the highest bits so sorting groups by it first
+	return ((unsigned long long)(shader->GetShaderID() & 0xFFFF) << 48) |
+		((unsigned long long)(texture->GetTextureID() & 0xFFFF) << 32) |
+		((unsigned long long)(material->GetMaterialID() & 0xFFFF) << 16) |
+		(unsigned long long)(vertexArray & 0xFFFF);
+}
+
+void RenderQueue::Flush()
+{
+	// Stable so draws with identical state keep their submission order from frame to frame
+	std::stable_sort(items.begin(), items.end(),
+		[](const RenderItem& a, const RenderItem& b) { return a.sortKey < b.sortKey; });
+
+	Shader* currentShader = NULL;
+	GLuint currentTexture = 0;
+	Material* currentMaterial = NULL;
+	GLuint currentVertexArray = 0;
+	int currentGroup = -1;
+
+	constexpr uint64_t MODEL = UniformName("model");
+	constexpr uint64_t NORMAL_MATRIX = UniformName("normalMatrix");
+	constexpr uint64_t TEXTURE_LAYER = UniformName("textureLayer");
+
+	stateChanges = 0;
+	stateChangesAvoided = 0;
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		RenderItem& item = items[i];
+
+		if (gpuTimer != NULL && item.group != currentGroup)
+		{
+			gpuTimer->BeginGroup(item.group);
+			currentGroup = item.group;
+		}
+
+		if (item.shader != currentShader)
+		{
+			item.shader->UseShader();
+
+			currentShader = item.shader;
+			currentMaterial = NULL; // material uniforms belong to the program
+			stateChanges++;
+		}
+		else
+		{
+			stateChangesAvoided++;
+		}
+
+		if (item.texture->GetTextureID() != currentTexture)
+		{
+			item.texture->UseTexture();
+			currentTexture = item.texture->GetTextureID();
+			stateChanges++;
+		}
+		else
+		{
+			stateChangesAvoided++;
+		}
+
+		// Shader caches the value, so consecutive draws on one layer don't reach GL
+		if (item.texture->GetArrayLayer() >= 0)
+		{
+			item.shader->Set(TEXTURE_LAYER, (GLint)item.texture->GetArrayLayer());
+		}
+
+		if (item.material != currentMaterial)
+		{
+			item.material->UseMaterial(item.shader);
+			currentMaterial = item.material;
+			stateChanges++;
+		}
+		else
+		{
+			stateChangesAvoided++;
+		}
+
+		// Meshes sharing a geometry arena share its VAO, so only the first of them binds
+		GLuint vertexArray = item.batch != NULL ? item.batch->GetVertexArray() : item.mesh->GetVertexArray(item.instanced);
+		if (vertexArray != currentVertexArray)
+		{
+			GLState::BindVertexArray(vertexArray);
+			currentVertexArray = vertexArray;
+			stateChanges++;
+		}
+		else
+		{
+			stateChangesAvoided++;
+		}
+
+		if (item.batch != NULL)
+		{
+			item.batch->DrawBatch(item.shader);
+		}
+		else if (item.instanced)
+		{
+			item.mesh->DrawMeshInstanced();
+		}
+		else
+		{
+			item.shader->Set(MODEL, item.transform);
+			item.shader->Set(NORMAL_MATRIX, item.normalMatrix);
+			item.mesh->DrawMesh();
+		}
+	}
+
+	if (gpuTimer != NULL)
+	{
+		gpuTimer->EndGroup();
+	}
+
+	// The last VAO stays bound; GLState skips rebinding it if the next frame starts with it
+
+	totalDraws += items.size();
+	totalVisible += visibleCount;
+	totalStateChanges += stateChanges;
+	totalAvoided += stateChangesAvoided;
+	totalCulled += culledCount;
+	framesFlushed++;
+}
+
+void RenderQueue::PrintStats()
+{
+	if (framesFlushed == 0)
+	{
+		return;
+	}
+
+	printf("Render queue: %.1f draws, %.1f state changes, %.1f redundant changes avoided per frame\n",
+		(double)totalDraws / framesFlushed, (double)totalStateChanges / framesFlushed, (double)totalAvoided / framesFlushed);
+
+	if (frustum != NULL)
+	{
+		printf("Frustum culling: %.1f visible, %.1f culled per frame\n",
+			(double)totalVisible / framesFlushed, (double)totalCulled / framesFlushed);
+	}
+}
+
+RenderQueue::~RenderQueue()
+{
+}
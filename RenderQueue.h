@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class Shader;
+class Mesh;
+class Texture;
+class Material;
+class GpuTimer;
+class Frustum;
+class StaticBatch;
+
+// Collects the frame's draws, sorts them by render state and submits them with redundant binds skipped
+//
+// Sort key, most significant first: shader | texture | material | vertex array (16 bits each)
+// Textures packed into one array share a texture id, so they sort and bind as one; each draw then
+// sets its layer (the textureLayer uniform) instead.
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Draws are timed under their group while flushing, if a timer is attached
+	void SetGpuTimer(GpuTimer* timer) { gpuTimer = timer; }
+
+	// Draws outside the frustum are dropped at submission; without one everything is kept
+	void SetFrustum(const Frustum* viewFrustum) { frustum = viewFrustum; }
+
+	void Begin();
+
+	void Submit(Shader* shader, Mesh* mesh, Texture* texture, Material* material, const glm::mat4& transform, int group);
+
+	// Draws every instance already uploaded to the mesh (see Mesh::UpdateInstances), never culled
+	void SubmitInstanced(Shader* shader, Mesh* mesh, Texture* texture, Material* material, int group);
+
+	// Draws every object of a built batch in one call, with a FEATURE_BATCHED shader; never culled
+	void SubmitBatch(Shader* shader, StaticBatch* batch, Texture* texture, Material* material, int group);
+
+	void Flush();
+
+	// State changes issued / skipped during the last flush
+	unsigned int GetStateChanges() { return stateChanges; }
+	unsigned int GetStateChangesAvoided() { return stateChangesAvoided; }
+
+	// Objects culled / kept by the frustum test since the last Begin; instanced and batched submits count each object they draw
+	unsigned int GetCulledCount() { return culledCount; }
+	unsigned int GetVisibleCount() { return visibleCount; }
+
+	void PrintStats();
+
+	~RenderQueue();
+
+private:
+	struct RenderItem
+	{
+		unsigned long long sortKey;
+		Shader* shader;
+		Mesh* mesh;
+		StaticBatch* batch; // instead of mesh for SubmitBatch
+		Texture* texture;
+		Material* material;
+		glm::mat4 transform;
+		glm::mat3 normalMatrix;
+		bool instanced;
+		int group;
+	};
+
+	std::vector<RenderItem> items;
+	GpuTimer* gpuTimer;
+	const Frustum* frustum;
+
+	unsigned int stateChanges, stateChangesAvoided;
+	unsigned int culledCount, visibleCount;
+
+	// Totals across all flushed frames
+	unsigned long long totalDraws, totalVisible, totalStateChanges, totalAvoided, totalCulled;
+	unsigned int framesFlushed;
+
+	bool IsVisible(Mesh* mesh, const glm::mat4& transform);
+	static unsigned long long MakeSortKey(Shader* shader, Texture* texture, Material* material, GLuint vertexArray);
+	void AddItem(Shader* shader, Mesh* mesh, Texture* texture, Material* material, const glm::mat4& transform, bool instanced, int group);
+};
@@ -1,75 +1,156 @@
 #include "Shader.h"
+#include "FrameUniforms.h"
+#include "ShaderCache.h"
+#include "Profiler.h"
+#include "GLState.h"
+
+#include <string.h>
+#include <utility>
+
+#include <glm/gtc/type_ptr.hpp>
 
 Shader::Shader()
 {
 	shaderID = 0;
-	uniformModel = 0;
-	uniformProjection = 0;
+	linked = false;
+	cacheHit = false;
+	cacheKey = 0;
+	vertexShaderID = 0;
+	fragmentShaderID = 0;
 }
 
 void Shader::CreateFromString(const char* vertCode, const char* fragCode)
 {
-	CompileShader(vertCode, fragCode);
+	CompileShader(ShaderSource(vertCode), ShaderSource(fragCode));
 }
 
 void Shader::CreateFromFiles(const char* vertexLocation, const char* fragmentLocation)
 {
-	std::string vertexString = ReadFile(vertexLocation);
-	std::string fragmentString = ReadFile(fragmentLocation);
+	ShaderSource vertexSource, fragmentSource;
+	if (!vertexSource.LoadFromFile(vertexLocation) || !fragmentSource.LoadFromFile(fragmentLocation))
+	{
+		return;
+	}
 
-	const char* vertCode = vertexString.c_str();
-	const char* fragCode = fragmentString.c_str();
+	CompileShader(vertexSource, fragmentSource);
+}
 
-	CompileShader(vertCode, fragCode);
+void Shader::CreateFromSources(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+	CompileShader(vertexSource, fragmentSource);
 }
 
 std::string Shader::ReadFile(const char* fileLocation)
 {
-	std::string content;
-	std::ifstream fileStream(fileLocation, std::ios::in);
-
-	if (!fileStream.is_open())
+	ShaderSource source;
+	if (!source.LoadFromFile(fileLocation))
 	{
-		printf("Failed to read %s! File doesn't exist.", fileLocation);
 		return "";
 	}
 
-	std::string line = "";
-	while (!fileStream.eof())
+	return source.ToString();
+}
+
+void Shader::CompileShader(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+	PROFILE_ZONE("Shader::CompileShader");
+
+	if (BeginCompile(vertexSource, fragmentSource))
 	{
-		std::getline(fileStream, line);
-		content.append(line + "\n");
+		FinishCompile();
 	}
-
-	fileStream.close();
-	return content;
 }
 
-void Shader::CompileShader(const char* vertCode, const char* fragCode)
+bool Shader::BeginCompile(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
 {
+	linked = false;
+	cacheHit = false;
+
 	shaderID = glCreateProgram();
 
 	if (!shaderID)
 	{
 		printf("Error creating shader program!\n");
-		return;
+		return false;
+	}
+
+	if (ShaderCache::IsEnabled())
+	{
+		cacheKey = ShaderCache::ComputeKey(vertexSource, fragmentSource);
+		if (ShaderCache::LoadProgram(cacheKey, shaderID))
+		{
+			cacheHit = true;
+			return true;
+		}
+
+		// Has to be set before linking for the driver to keep a binary we can save
+		glProgramParameteri(shaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Nothing below waits on the compiler; errors are collected in FinishCompile
+	vertexShaderID = AddShader(shaderID, vertexSource, GL_VERTEX_SHADER);
+	fragmentShaderID = AddShader(shaderID, fragmentSource, GL_FRAGMENT_SHADER);
+
+	glLinkProgram(shaderID);
+
+	return true;
+}
+
+bool Shader::IsCompileComplete()
+{
+	if (shaderID == 0 || cacheHit || !GLEW_KHR_parallel_shader_compile)
+	{
+		return true;
+	}
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(shaderID, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool Shader::FinishCompile()
+{
+	if (shaderID == 0)
+	{
+		return false;
 	}
 
-	AddShader(shaderID, vertCode, GL_VERTEX_SHADER);
-	AddShader(shaderID, fragCode, GL_FRAGMENT_SHADER);
+	if (cacheHit)
+	{
+		linked = true;
+		QueryUniforms();
+		return true;
+	}
 
 	GLint result = 0;
 	GLchar eLog[1024] = { 0 };
 
-	glLinkProgram(shaderID);
+	bool compiled = CheckShader(vertexShaderID, GL_VERTEX_SHADER);
+	compiled = CheckShader(fragmentShaderID, GL_FRAGMENT_SHADER) && compiled;
+
+	// The program keeps what it needs once linked
+	glDetachShader(shaderID, vertexShaderID);
+	glDetachShader(shaderID, fragmentShaderID);
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+	vertexShaderID = 0;
+	fragmentShaderID = 0;
+
+	if (!compiled)
+	{
+		return false;
+	}
+
 	glGetProgramiv(shaderID, GL_LINK_STATUS, &result);
 	if (!result)
 	{
 		glGetProgramInfoLog(shaderID, sizeof(eLog), NULL, eLog);
 		printf("Error linking program: '%s'\n", eLog);
-		return;
+		return false;
 	}
 
+	// Validation is slow on some drivers and only says something useful while developing
+#ifdef _DEBUG
 	glValidateProgram(shaderID);
 	glGetProgramiv(shaderID, GL_VALIDATE_STATUS, &result);
 	if (!result)
@@ -78,101 +159,234 @@ void Shader::CompileShader(const char* vertCode, const char* fragCode)
 		printf("Error validating program: '%s'\n", eLog);
 		//return;
 	}
+#endif
 
-	// Get the ID/Location of the uniform variable
-	uniformModel = glGetUniformLocation(shaderID, "model");
-	uniformProjection = glGetUniformLocation(shaderID, "projection");
-	uniformView = glGetUniformLocation(shaderID, "view");
-	uniformAmbientColor = glGetUniformLocation(shaderID, "directionalLight.color");
-	uniformAmbientIntensity = glGetUniformLocation(shaderID, "directionalLight.ambientIntensity");
-	uniformDiffuseIntensity = glGetUniformLocation(shaderID, "directionalLight.diffuseIntensity");
-	uniformDirection = glGetUniformLocation(shaderID, "directionalLight.direction");
-	uniformEyePosition = glGetUniformLocation(shaderID, "eyePosition");
-	uniformSpecularIntensity = glGetUniformLocation(shaderID, "material.specularIntensity");
-	uniformShininess = glGetUniformLocation(shaderID, "material.shininess");
+	if (ShaderCache::IsEnabled())
+	{
+		ShaderCache::SaveProgram(cacheKey, shaderID);
+	}
+
+	linked = true;
+	QueryUniforms();
+	return true;
+}
+
+void Shader::SwapProgram(Shader& other)
+{
+	std::swap(shaderID, other.shaderID);
+	std::swap(linked, other.linked);
+	uniformTable.swap(other.uniformTable);
 }
 
-// Getters
-GLuint Shader::GetProjectionLocation()
+void Shader::QueryUniforms()
 {
-	return uniformProjection;
+	uniformTable.clear();
+
+	GLint uniformCount = 0, maxNameLength = 0;
+	glGetProgramiv(shaderID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	// At most half full, so probe sequences stay short; each array adds a second name for itself
+	size_t capacity = 8;
+	while (capacity < (size_t)uniformCount * 4)
+	{
+		capacity *= 2;
+	}
+	uniformTable.assign(capacity, UniformSlot());
+	for (size_t i = 0; i < capacity; i++)
+	{
+		uniformTable[i].hash = 0;
+	}
+
+	std::vector<GLchar> name(maxNameLength > 0 ? maxNameLength : 1);
+
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(shaderID, (GLuint)i, (GLsizei)name.size(), &nameLength, &size, &type, name.data());
+
+		// Members of uniform blocks have no location of their own
+		GLint location = glGetUniformLocation(shaderID, name.data());
+		if (location < 0)
+		{
+			continue;
+		}
+
+		std::string_view uniformName(name.data(), nameLength);
+		InsertUniform(HashString(uniformName), location);
+
+		// Arrays are reported as "name[0]"; also answer to the bare name like glGetUniformLocation does
+		if (uniformName.size() > 3 && uniformName.substr(uniformName.size() - 3) == "[0]")
+		{
+			InsertUniform(HashString(uniformName.substr(0, uniformName.size() - 3)), location);
+		}
+	}
+
+	// Point the program's PerFrame block at the shared uniform buffer
+	GLuint perFrameIndex = glGetUniformBlockIndex(shaderID, "PerFrame");
+	if (perFrameIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(shaderID, perFrameIndex, PER_FRAME_BINDING);
+	}
 }
 
-GLuint Shader::GetModelLocation()
+void Shader::InsertUniform(uint64_t hash, GLint location)
 {
-	return uniformModel;
+	size_t mask = uniformTable.size() - 1;
+
+	// Linear probing from the hash's home slot
+	for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask)
+	{
+		if (uniformTable[i].hash == 0)
+		{
+			uniformTable[i].hash = hash;
+			uniformTable[i].location = location;
+			uniformTable[i].valueSize = 0;
+			return;
+		}
+
+		if (uniformTable[i].hash == hash)
+		{
+			printf("Uniform name hash collision in program %u, location %d is shadowed\n", shaderID, location);
+			return;
+		}
+	}
 }
 
-GLuint Shader::GetViewLocation()
+Shader::UniformSlot* Shader::FindUniform(uint64_t nameHash)
 {
-	return uniformView;
+	if (uniformTable.empty())
+	{
+		return NULL;
+	}
+
+	size_t mask = uniformTable.size() - 1;
+
+	// The table is never full, so an empty slot always ends the search
+	for (size_t i = (size_t)nameHash & mask; ; i = (i + 1) & mask)
+	{
+		if (uniformTable[i].hash == nameHash)
+		{
+			return &uniformTable[i];
+		}
+
+		if (uniformTable[i].hash == 0)
+		{
+			return NULL;
+		}
+	}
 }
 
-GLuint Shader::GetAmbientColorLocation()
+GLint Shader::Uniform(std::string_view name)
 {
-	return uniformAmbientColor;
+	return Uniform(HashString(name));
 }
 
-GLuint Shader::GetAmbientIntensityLocation()
+GLint Shader::Uniform(uint64_t nameHash)
 {
-	return uniformAmbientIntensity;
+	UniformSlot* slot = FindUniform(nameHash);
+	return slot != NULL ? slot->location : -1;
 }
 
-GLuint Shader::GetDiffuseIntensityLocation()
+bool Shader::UpdateCachedValue(UniformSlot* slot, const void* value, GLsizei size)
 {
-	return uniformDiffuseIntensity;
+	if (slot == NULL)
+	{
+		return false;
+	}
+
+	size_t bytes = sizeof(GLfloat) * size;
+	if (slot->valueSize == size && memcmp(slot->value, value, bytes) == 0)
+	{
+		return false;
+	}
+
+	memcpy(slot->value, value, bytes);
+	slot->valueSize = size;
+	return true;
 }
 
-GLuint Shader::GetDirectionLocation()
+void Shader::Set(uint64_t nameHash, const glm::mat4& value)
 {
-	return uniformDirection;
+	UniformSlot* slot = FindUniform(nameHash);
+	if (UpdateCachedValue(slot, glm::value_ptr(value), 16))
+	{
+		glUniformMatrix4fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+	}
 }
 
-GLuint Shader::GetEyePositionLocation()
+void Shader::Set(uint64_t nameHash, const glm::mat3& value)
 {
-	return uniformEyePosition;
+	UniformSlot* slot = FindUniform(nameHash);
+	if (UpdateCachedValue(slot, glm::value_ptr(value), 9))
+	{
+		glUniformMatrix3fv(slot->location, 1, GL_FALSE, glm::value_ptr(value));
+	}
 }
 
-GLuint Shader::GetSpecularIntensityLocation()
+void Shader::Set(uint64_t nameHash, const glm::vec3& value)
 {
-	return uniformSpecularIntensity;
+	UniformSlot* slot = FindUniform(nameHash);
+	if (UpdateCachedValue(slot, glm::value_ptr(value), 3))
+	{
+		glUniform3f(slot->location, value.x, value.y, value.z);
+	}
 }
 
-GLuint Shader::GetShininessLocation()
+void Shader::Set(uint64_t nameHash, GLfloat value)
 {
-	return uniformShininess;
+	UniformSlot* slot = FindUniform(nameHash);
+	if (UpdateCachedValue(slot, &value, 1))
+	{
+		glUniform1f(slot->location, value);
+	}
 }
 
+void Shader::Set(uint64_t nameHash, GLint value)
+{
+	// Compared bit for bit, so sharing the float storage is fine
+	UniformSlot* slot = FindUniform(nameHash);
+	if (UpdateCachedValue(slot, &value, 1))
+	{
+		glUniform1i(slot->location, value);
+	}
+}
 
 void Shader::UseShader()
 {
-	glUseProgram(shaderID);
+	GLState::UseProgram(shaderID);
 }
 
 void Shader::ClearShader()
 {
 	if (shaderID != 0)
 	{
+		GLState::ForgetProgram(shaderID);
 		glDeleteProgram(shaderID);
 		shaderID = 0;
 	}
 
-	uniformModel = 0;
-	uniformProjection = 0;
+	linked = false;
+	uniformTable.clear();
 }
 
-void Shader::AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType)
+GLuint Shader::AddShader(GLuint theProgram, const ShaderSource& source, GLenum shaderType)
 {
 	GLuint theShader = glCreateShader(shaderType);
 
-	const GLchar* theCode[1];
-	theCode[0] = shaderCode;
+	// The pieces go to the driver as they are; it does the only concatenation
+	glShaderSource(theShader, source.GetCount(), source.GetStrings(), source.GetLengths());
+	glCompileShader(theShader);
+
+	glAttachShader(theProgram, theShader);
 
-	GLint codeLength[1];
-	codeLength[0] = strlen(shaderCode);
+	return theShader;
+}
 
-	glShaderSource(theShader, 1, theCode, codeLength);
-	glCompileShader(theShader);
+bool Shader::CheckShader(GLuint theShader, GLenum shaderType)
+{
 	GLint result = 0;
 	GLchar eLog[1024] = { 0 };
 
@@ -181,10 +395,10 @@ void Shader::AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderT
 	{
 		glGetShaderInfoLog(theShader, sizeof(eLog), NULL, eLog);
 		printf("Error compiling the %d shader: '%s'\n", shaderType, eLog);
-		return;
+		return false;
 	}
 
-	glAttachShader(theProgram, theShader);
+	return true;
 }
 
 
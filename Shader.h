@@ -1,9 +1,23 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+#include "ShaderSource.h"
+
+// Uniform names hashed by the compiler, e.g. constexpr uint64_t MODEL = UniformName("model");
+// Lookups with these never touch the string at runtime
+constexpr uint64_t UniformName(std::string_view name)
+{
+	return HashString(name);
+}
 
 class Shader
 {
@@ -12,20 +26,34 @@ public:
 
 	void CreateFromString(const char* vertCode, const char* fragCode);
 	void CreateFromFiles(const char* vertexLocation, const char* fragmentLocation);
+	void CreateFromSources(const ShaderSource& vertexSource, const ShaderSource& fragmentSource);
 
+	// Whole file with its #includes resolved, as one string
 	std::string ReadFile(const char* fileLocation);
 
-	GLuint GetProjectionLocation();
-	GLuint GetModelLocation();
-	GLuint GetViewLocation();
-	GLuint GetAmbientIntensityLocation();
-	GLuint GetAmbientColorLocation();
-	GLuint GetDiffuseIntensityLocation();
-	GLuint GetDirectionLocation();
-	GLuint GetEyePositionLocation();
-	GLuint GetSpecularIntensityLocation();
-	GLuint GetShininessLocation();
+	// Location of an active uniform, or -1 if the program doesn't use it
+	GLint Uniform(std::string_view name);
+	GLint Uniform(uint64_t nameHash);
+
+	// Uploads to the current program (UseShader first), skipped when the uniform already holds the value
+	void Set(uint64_t nameHash, const glm::mat4& value);
+	void Set(uint64_t nameHash, const glm::mat3& value);
+	void Set(uint64_t nameHash, const glm::vec3& value);
+	void Set(uint64_t nameHash, GLfloat value);
+	void Set(uint64_t nameHash, GLint value);
+
+	// Split compile for callers that must not block on the driver: BeginCompile submits the
+	// sources, IsCompileComplete polls GL_KHR_parallel_shader_compile (always true without it)
+	// and FinishCompile collects the logs. Returns false when the program failed to build.
+	bool BeginCompile(const ShaderSource& vertexSource, const ShaderSource& fragmentSource);
+	bool IsCompileComplete();
+	bool FinishCompile();
+
+	// Exchanges programs with another shader, used to put a reloaded program in place
+	void SwapProgram(Shader& other);
 
+	GLuint GetShaderID() { return shaderID; }
+	bool IsLinked() { return linked; }
 
 	void UseShader();
 	void ClearShader();
@@ -33,11 +61,35 @@ public:
 	~Shader();
 
 private:
-	GLuint shaderID, uniformProjection, uniformModel, uniformView, uniformEyePosition, 
-		uniformAmbientIntensity, uniformAmbientColor, uniformDiffuseIntensity, uniformDirection, 
-		uniformSpecularIntensity, uniformShininess;
+	// One slot of the open-addressed uniform table; hash 0 marks an empty slot
+	struct UniformSlot
+	{
+		uint64_t hash;
+		GLint location;
+		GLsizei valueSize; // floats (or ints) held in value, 0 until the first Set
+		GLfloat value[16];
+	};
 
-	void CompileShader(const char* vertCode, const char* fragCode);
-	void AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
-};
+	// Camera and light uniforms live in the PerFrame block (see FrameUniforms.h)
+	GLuint shaderID;
+	bool linked;
+
+	// In-flight compile state between BeginCompile and FinishCompile
+	bool cacheHit;
+	uint64_t cacheKey;
+	GLuint vertexShaderID, fragmentShaderID;
+
+	// Power-of-two sized, filled once after linking from the program's active uniforms
+	std::vector<UniformSlot> uniformTable;
 
+	void CompileShader(const ShaderSource& vertexSource, const ShaderSource& fragmentSource);
+	void QueryUniforms();
+	void InsertUniform(uint64_t hash, GLint location);
+	UniformSlot* FindUniform(uint64_t nameHash);
+
+	// True when the slot needs the upload, and remembers the new value
+	bool UpdateCachedValue(UniformSlot* slot, const void* value, GLsizei size);
+
+	GLuint AddShader(GLuint theProgram, const ShaderSource& source, GLenum shaderType);
+	bool CheckShader(GLuint theShader, GLenum shaderType);
+};
@@ -0,0 +1,195 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include "ShaderSource.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x43425053; // "SPBC"
+	const uint32_t CACHE_VERSION = 1;
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key; // guards against two keys landing on the same file name
+		GLenum format;
+		GLint length;
+	};
+
+	uint64_t HashGLString(GLenum name, uint64_t hash)
+	{
+		const char* value = (const char*)glGetString(name);
+		if (value == NULL)
+		{
+			return hash;
+		}
+
+		return HashBytes(value, strlen(value) + 1, hash);
+	}
+}
+
+bool ShaderCache::enabled = false;
+std::string ShaderCache::cacheDirectory;
+uint64_t ShaderCache::driverHash = FNV_OFFSET_BASIS;
+std::atomic<unsigned int> ShaderCache::hits(0);
+std::atomic<unsigned int> ShaderCache::misses(0);
+std::atomic<unsigned int> ShaderCache::rejected(0);
+
+void ShaderCache::Initialize(const char* directory)
+{
+	GLint formatCount = 0;
+	if (GLEW_ARB_get_program_binary || GLEW_VERSION_4_1)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+
+	if (formatCount == 0)
+	{
+		printf("Shader cache disabled: the driver has no program binary formats\n");
+		return;
+	}
+
+#ifdef _WIN32
+	_mkdir(directory);
+#else
+	mkdir(directory, 0755);
+#endif
+
+	cacheDirectory = directory;
+
+	driverHash = FNV_OFFSET_BASIS;
+	driverHash = HashGLString(GL_VENDOR, driverHash);
+	driverHash = HashGLString(GL_RENDERER, driverHash);
+	driverHash = HashGLString(GL_VERSION, driverHash);
+
+	enabled = true;
+}
+
+uint64_t ShaderCache::ComputeKey(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+	// The terminators keep "ab" + "c" and "a" + "bc" apart
+	const char terminator = 0;
+	uint64_t key = HashBytes(&terminator, 1, vertexSource.Hash(driverHash));
+	return HashBytes(&terminator, 1, fragmentSource.Hash(key));
+}
+
+std::string ShaderCache::GetEntryLocation(uint64_t key)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)key);
+
+	return cacheDirectory + "/" + fileName;
+}
+
+bool ShaderCache::LoadProgram(uint64_t key, GLuint program)
+{
+	PROFILE_ZONE("ShaderCache::LoadProgram");
+
+	std::string location = GetEntryLocation(key);
+
+	FILE* file = fopen(location.c_str(), "rb");
+	if (file == NULL)
+	{
+		misses++;
+		return false;
+	}
+
+	CacheHeader header;
+	std::vector<char> binary;
+
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == CACHE_MAGIC && header.version == CACHE_VERSION && header.key == key && header.length > 0;
+
+	if (valid)
+	{
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+
+	fclose(file);
+
+	GLint linked = GL_FALSE;
+	if (valid)
+	{
+		glProgramBinary(program, header.format, binary.data(), header.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	}
+
+	if (!linked)
+	{
+		// Truncated, from another build of the driver, or otherwise unusable: compile and overwrite it
+		remove(location.c_str());
+		rejected++;
+		misses++;
+		return false;
+	}
+
+	hits++;
+	return true;
+}
+
+void ShaderCache::SaveProgram(uint64_t key, GLuint program)
+{
+	PROFILE_ZONE("ShaderCache::SaveProgram");
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.key = key;
+
+	std::vector<char> binary(length);
+	glGetProgramBinary(program, length, &header.length, &header.format, binary.data());
+	if (header.length <= 0)
+	{
+		return;
+	}
+
+	// Written under a temporary name first so a crash never leaves a half-written entry behind
+	std::string location = GetEntryLocation(key);
+	std::string tempLocation = location + ".tmp";
+
+	FILE* file = fopen(tempLocation.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("Failed to write shader cache entry %s\n", tempLocation.c_str());
+		return;
+	}
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(binary.data(), 1, header.length, file) == (size_t)header.length;
+	fclose(file);
+
+	remove(location.c_str());
+	if (!written || rename(tempLocation.c_str(), location.c_str()) != 0)
+	{
+		remove(tempLocation.c_str());
+	}
+}
+
+void ShaderCache::PrintStats()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	printf("Shader cache: %u hits, %u misses (%u stale entries replaced)\n", hits.load(), misses.load(), rejected.load());
+}
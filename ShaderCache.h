@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+
+#include <GL/glew.h>
+
+class ShaderSource;
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary)
+//
+// Entries are keyed on a hash of the shader sources and the driver's vendor, renderer and version
+// strings, so a driver update or an edited shader just misses and the program is compiled again
+class ShaderCache
+{
+public:
+	// Stays disabled if the driver can't hand out program binaries
+	static void Initialize(const char* directory);
+	static bool IsEnabled() { return enabled; }
+
+	static uint64_t ComputeKey(const ShaderSource& vertexSource, const ShaderSource& fragmentSource);
+
+	// Links the program from its cached binary; false on a miss or when the driver rejects the binary
+	static bool LoadProgram(uint64_t key, GLuint program);
+
+	// The program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	static void SaveProgram(uint64_t key, GLuint program);
+
+	static void PrintStats();
+
+private:
+	static bool enabled;
+	static std::string cacheDirectory;
+	static uint64_t driverHash;
+	static std::atomic<unsigned int> hits, misses, rejected; // programs can be compiled on more than one thread
+
+	static std::string GetEntryLocation(uint64_t key);
+};
@@ -0,0 +1,353 @@
+#include "ShaderSource.h"
+#include "Hash.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+
+namespace
+{
+	const unsigned int MAX_INCLUDE_DEPTH = 16;
+
+	struct IncludeLine
+	{
+		size_t start, end; // the whole line, newline included
+		unsigned int line; // 1-based
+		std::string name;
+	};
+
+	struct CachedFile
+	{
+		std::filesystem::file_time_type writeTime;
+		uintmax_t size;
+		std::shared_ptr<const std::string> text;
+		std::vector<IncludeLine> includes;
+	};
+
+	// Shared by every ShaderSource; variants and hot reloads load on different threads
+	std::unordered_map<std::string, std::shared_ptr<const CachedFile>> fileCache;
+	std::mutex fileCacheMutex;
+	unsigned int filesRead = 0, cacheHits = 0;
+
+	// Matches `#include "name"`, with any spacing GLSL allows around the tokens
+	bool ParseInclude(const char* line, const char* lineEnd, std::string& name)
+	{
+		while (line < lineEnd && (*line == ' ' || *line == '\t'))
+		{
+			line++;
+		}
+		if (line == lineEnd || *line++ != '#')
+		{
+			return false;
+		}
+		while (line < lineEnd && (*line == ' ' || *line == '\t'))
+		{
+			line++;
+		}
+		if (lineEnd - line < 7 || strncmp(line, "include", 7) != 0)
+		{
+			return false;
+		}
+		line += 7;
+		while (line < lineEnd && (*line == ' ' || *line == '\t'))
+		{
+			line++;
+		}
+		if (line == lineEnd || *line++ != '"')
+		{
+			return false;
+		}
+
+		const char* nameEnd = (const char*)memchr(line, '"', lineEnd - line);
+		if (nameEnd == NULL || nameEnd == line)
+		{
+			return false;
+		}
+
+		name.assign(line, nameEnd - line);
+		return true;
+	}
+
+	std::shared_ptr<const CachedFile> ReadSourceFile(const std::string& location)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(location, error);
+		uintmax_t size = error ? 0 : std::filesystem::file_size(location, error);
+		if (error)
+		{
+			return NULL;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(fileCacheMutex);
+
+			std::unordered_map<std::string, std::shared_ptr<const CachedFile>>::iterator found = fileCache.find(location);
+			if (found != fileCache.end() && found->second->writeTime == writeTime && found->second->size == size)
+			{
+				cacheHits++;
+				return found->second;
+			}
+		}
+
+		PROFILE_ZONE("ShaderSource::ReadFile");
+
+		FILE* file = fopen(location.c_str(), "rb");
+		if (file == NULL)
+		{
+			return NULL;
+		}
+
+		// One allocation and one read; a file that shrank since the size check just comes back shorter
+		std::shared_ptr<std::string> text = std::make_shared<std::string>();
+		text->resize((size_t)size);
+		text->resize(fread(&(*text)[0], 1, (size_t)size, file));
+		fclose(file);
+
+		std::shared_ptr<CachedFile> cached = std::make_shared<CachedFile>();
+		cached->writeTime = writeTime;
+		cached->size = size;
+		cached->text = text;
+
+		const char* data = text->data();
+		const char* dataEnd = data + text->size();
+		unsigned int lineNumber = 1;
+		for (const char* line = data; line < dataEnd; lineNumber++)
+		{
+			const char* newline = (const char*)memchr(line, '\n', dataEnd - line);
+			const char* lineEnd = newline != NULL ? newline : dataEnd;
+
+			std::string name;
+			if (ParseInclude(line, lineEnd, name))
+			{
+				IncludeLine include;
+				include.start = line - data;
+				include.end = newline != NULL ? newline + 1 - data : text->size();
+				include.line = lineNumber;
+				include.name = name;
+				cached->includes.push_back(include);
+			}
+
+			line = newline != NULL ? newline + 1 : dataEnd;
+		}
+
+		std::lock_guard<std::mutex> lock(fileCacheMutex);
+		fileCache[location] = cached;
+		filesRead++;
+
+		return cached;
+	}
+
+	std::string GetDirectory(const std::string& location)
+	{
+		size_t slash = location.find_last_of("/\\");
+		return slash == std::string::npos ? "" : location.substr(0, slash + 1);
+	}
+}
+
+ShaderSource::ShaderSource()
+{
+}
+
+ShaderSource::ShaderSource(const char* code)
+{
+	AppendPiece(code, strlen(code));
+}
+
+bool ShaderSource::LoadFromFile(const char* fileLocation)
+{
+	strings.clear();
+	lengths.clear();
+	files.clear();
+	buffers.clear();
+
+	return AppendFile(fileLocation, 0);
+}
+
+bool ShaderSource::AppendFile(const std::string& fileLocation, unsigned int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH)
+	{
+		printf("Failed to read %s! Includes nest deeper than %u files.\n", fileLocation.c_str(), MAX_INCLUDE_DEPTH);
+		return false;
+	}
+
+	std::shared_ptr<const CachedFile> file = ReadSourceFile(fileLocation);
+	if (file == NULL)
+	{
+		printf("Failed to read %s! File doesn't exist.\n", fileLocation.c_str());
+		return false;
+	}
+
+	unsigned int fileIndex = (unsigned int)files.size();
+	files.push_back(fileLocation);
+	buffers.push_back(file->text);
+
+	const char* data = file->text->data();
+	size_t position = 0;
+
+	for (size_t i = 0; i < file->includes.size(); i++)
+	{
+		const IncludeLine& include = file->includes[i];
+		AppendPiece(data + position, include.start - position);
+		position = include.end;
+
+		std::string includeLocation = GetDirectory(fileLocation) + include.name;
+
+		bool included = false;
+		for (size_t j = 0; j < files.size(); j++)
+		{
+			included = included || files[j] == includeLocation;
+		}
+		if (included)
+		{
+			continue; // already pasted in once (or including itself)
+		}
+
+		// The leading newline covers an included file whose last line has none
+		AppendOwned("\n#line 1 " + std::to_string(files.size()) + "\n");
+		if (!AppendFile(includeLocation, depth + 1))
+		{
+			return false;
+		}
+		AppendOwned("\n#line " + std::to_string(include.line + 1) + " " + std::to_string(fileIndex) + "\n");
+	}
+
+	AppendPiece(data + position, file->text->size() - position);
+
+	return true;
+}
+
+void ShaderSource::AppendPiece(const GLchar* data, size_t length)
+{
+	strings.push_back(data);
+	lengths.push_back((GLint)length);
+}
+
+void ShaderSource::AppendOwned(const std::string& text)
+{
+	std::shared_ptr<const std::string> buffer = std::make_shared<const std::string>(text);
+	buffers.push_back(buffer);
+	AppendPiece(buffer->data(), buffer->size());
+}
+
+void ShaderSource::InsertAfterVersion(const std::string& text)
+{
+	size_t piece = 0, split = 0;
+	unsigned int nextLine = 1;
+	std::string prefix;
+
+	for (size_t i = 0; i < strings.size(); i++)
+	{
+		std::string_view view(strings[i], lengths[i]);
+		size_t version = view.find("#version");
+		if (version == std::string_view::npos)
+		{
+			continue;
+		}
+
+		size_t lineEnd = view.find('\n', version);
+		piece = i;
+		split = lineEnd == std::string_view::npos ? view.size() : lineEnd + 1;
+		prefix = lineEnd == std::string_view::npos ? "\n" : "";
+
+		// Only the first piece starts at line 1 of the loaded file; elsewhere leave the numbering alone
+		nextLine = 0;
+		if (i == 0)
+		{
+			nextLine = 2;
+			for (size_t j = 0; j < lineEnd && j < view.size(); j++)
+			{
+				nextLine += view[j] == '\n';
+			}
+		}
+		break;
+	}
+
+	std::string inserted = prefix + text;
+	if (!inserted.empty() && inserted.back() != '\n')
+	{
+		inserted += '\n';
+	}
+	if (nextLine > 0)
+	{
+		inserted += "#line " + std::to_string(nextLine) + " 0\n";
+	}
+
+	std::shared_ptr<const std::string> buffer = std::make_shared<const std::string>(inserted);
+	buffers.push_back(buffer);
+
+	if (strings.empty())
+	{
+		AppendPiece(buffer->data(), buffer->size());
+		return;
+	}
+
+	// Split the piece holding #version around the new text
+	const GLchar* tail = strings[piece] + split;
+	GLint tailLength = lengths[piece] - (GLint)split;
+	lengths[piece] = (GLint)split;
+
+	strings.insert(strings.begin() + piece + 1, { buffer->data(), tail });
+	lengths.insert(lengths.begin() + piece + 1, { (GLint)buffer->size(), tailLength });
+}
+
+bool ShaderSource::DependsOn(const std::string& fileName) const
+{
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (std::filesystem::path(files[i]).filename().string() == fileName)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint64_t ShaderSource::Hash(uint64_t hash) const
+{
+	for (size_t i = 0; i < strings.size(); i++)
+	{
+		hash = HashBytes(strings[i], lengths[i], hash);
+	}
+
+	return hash;
+}
+
+std::string ShaderSource::ToString() const
+{
+	size_t size = 0;
+	for (size_t i = 0; i < lengths.size(); i++)
+	{
+		size += lengths[i];
+	}
+
+	std::string source;
+	source.reserve(size);
+	for (size_t i = 0; i < strings.size(); i++)
+	{
+		source.append(strings[i], lengths[i]);
+	}
+
+	return source;
+}
+
+void ShaderSource::ClearFileCache()
+{
+	std::lock_guard<std::mutex> lock(fileCacheMutex);
+	fileCache.clear();
+}
+
+void ShaderSource::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(fileCacheMutex);
+	printf("Shader sources: %u files read, %u loads served from the file cache\n", filesRead, cacheHits);
+}
+
+ShaderSource::~ShaderSource()
+{
+}
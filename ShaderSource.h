@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <GL/glew.h>
+
+// One shader stage's source as the pieces glShaderSource takes, with #include "file" lines replaced
+// by the included file's pieces
+//
+// Files are read with a single sized read into a per-file cache (checked against the file's size and
+// modification time), and the pieces point straight into those buffers, so a shader that includes
+// PerFrame.glsl doesn't copy it and loading the same file twice doesn't read it twice.
+// Each file is included at most once. #line directives keep compiler errors pointing at the right
+// file and line: the first number of an error is the file's index in GetFiles().
+class ShaderSource
+{
+public:
+	ShaderSource();
+
+	// A single piece pointing at code, which has to outlive this object and any copy of it
+	explicit ShaderSource(const char* code);
+
+	bool LoadFromFile(const char* fileLocation);
+
+	// Adds text on the line after #version (where #defines have to go), or at the start without one
+	void InsertAfterVersion(const std::string& text);
+
+	GLsizei GetCount() const { return (GLsizei)strings.size(); }
+	const GLchar* const* GetStrings() const { return strings.data(); }
+	const GLint* GetLengths() const { return lengths.data(); }
+
+	// The loaded file first, then everything it includes
+	const std::vector<std::string>& GetFiles() const { return files; }
+
+	// True if fileName (no directory) is the loaded file or one of its includes
+	bool DependsOn(const std::string& fileName) const;
+
+	// Hash of the pieces as if they were one string, continuing from hash
+	uint64_t Hash(uint64_t hash) const;
+
+	std::string ToString() const;
+
+	static void ClearFileCache();
+	static void PrintStats();
+
+	~ShaderSource();
+
+private:
+	std::vector<const GLchar*> strings;
+	std::vector<GLint> lengths;
+	std::vector<std::string> files;
+
+	// Keeps every buffer the pieces point into alive, even if the file cache replaces it
+	std::vector<std::shared_ptr<const std::string>> buffers;
+
+	bool AppendFile(const std::string& fileLocation, unsigned int depth);
+	void AppendPiece(const GLchar* data, size_t length);
+	void AppendOwned(const std::string& text);
+};
@@ -0,0 +1,444 @@
+#include "ShaderVariants.h"
+#include "Shader.h"
+#include "Window.h"
+#include "Profiler.h"
+
+
+std::string GetFeatureDefines(ShaderFeatures features)
+{
+	std::string defines;
+
+	if (features & FEATURE_TEXTURE)
+	{
+		defines += "#define TEXTURE\n";
+	}
+	if (features & FEATURE_SPECULAR)
+	{
+		defines += "#define SPECULAR\n";
+	}
+	if (features & FEATURE_INSTANCED)
+	{
+		defines += "#define INSTANCED\n";
+	}
+	if (features & FEATURE_TEXTURE_ARRAY)
+	{
+		defines += "#define TEXTURE_ARRAY\n";
+	}
+	if (features & FEATURE_BATCHED)
+	{
+		defines += "#define BATCHED\n";
+	}
+
+	if (features & FEATURE_LIGHTS_16)
+	{
+		defines += "#define LIGHT_COUNT 16\n";
+	}
+	else if (features & FEATURE_LIGHTS_4)
+	{
+		defines += "#define LIGHT_COUNT 4\n";
+	}
+
+	return defines;
+}
+
+ShaderVariants::ShaderVariants(const char* vertexLocation, const char* fragmentLocation)
+{
+	this->vertexLocation = vertexLocation;
+	this->fragmentLocation = fragmentLocation;
+
+	// Read once; every variant is the same source with different defines
+	vertexSource.LoadFromFile(vertexLocation);
+	fragmentSource.LoadFromFile(fragmentLocation);
+
+	sharedContextWindow = NULL;
+	stopping = false;
+	backgroundRunning = false;
+}
+
+Shader* ShaderVariants::Compile(ShaderFeatures features)
+{
+	PROFILE_ZONE("ShaderVariants::Compile");
+
+	// Copies only the piece list; a reload may replace the sources from the main thread
+	ShaderSource vertCode, fragCode;
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		vertCode = vertexSource;
+		fragCode = fragmentSource;
+	}
+
+	std::string defines = GetFeatureDefines(features);
+	vertCode.InsertAfterVersion(defines);
+	fragCode.InsertAfterVersion(defines);
+
+	Shader* shader = new Shader();
+	shader->CreateFromSources(vertCode, fragCode);
+
+	return shader;
+}
+
+Shader* ShaderVariants::Get(ShaderFeatures features)
+{
+	if (!IsValidFeatureSet(features))
+	{
+		printf("Invalid shader feature set 0x%x\n", features);
+		return NULL;
+	}
+
+	std::unique_lock<std::mutex> lock(variantMutex);
+
+	std::unordered_map<ShaderFeatures, Variant>::iterator found = variants.find(features);
+	if (found != variants.end())
+	{
+		if (found->second.state == VARIANT_COMPILING)
+		{
+			variantReady.wait(lock, [this, features]() { return variants[features].state == VARIANT_READY; });
+		}
+
+		if (variants[features].state == VARIANT_READY)
+		{
+			return variants[features].shader;
+		}
+	}
+
+	// Not started yet (or still waiting in the background queue): take it and compile it here
+	Variant& variant = variants[features];
+	variant.shader = NULL;
+	variant.state = VARIANT_COMPILING;
+	variant.needsRebuild = false;
+	lock.unlock();
+
+	Shader* shader = Compile(features);
+
+	lock.lock();
+	FinishVariant(features, shader);
+
+	return shader;
+}
+
+void ShaderVariants::FinishVariant(ShaderFeatures features, Shader* shader)
+{
+	Variant& variant = variants[features];
+	variant.shader = shader;
+	variant.state = VARIANT_READY;
+
+	// A reload came in while this compiled from the sources it replaced
+	if (variant.needsRebuild)
+	{
+		variant.needsRebuild = false;
+		staleVariants.push_back(features);
+	}
+
+	variantReady.notify_all();
+}
+
+bool ShaderVariants::CompileRemainingInBackground(Window* window)
+{
+	if (backgroundThread.joinable() || !window->createSharedContext())
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+
+		for (ShaderFeatures features = 0; features < (1u << FEATURE_COUNT); features++)
+		{
+			if (IsValidFeatureSet(features) && variants.find(features) == variants.end())
+			{
+				variants[features].shader = NULL;
+				variants[features].state = VARIANT_QUEUED;
+				variants[features].needsRebuild = false;
+				backgroundQueue.push_back(features);
+			}
+		}
+	}
+
+	sharedContextWindow = window;
+
+	return StartBackgroundThread();
+}
+
+bool ShaderVariants::StartBackgroundThread()
+{
+	std::unique_lock<std::mutex> lock(variantMutex);
+	if (backgroundRunning || sharedContextWindow == NULL)
+	{
+		return backgroundRunning;
+	}
+
+	// A previous thread ran out of work; it has released the context by the time the flag drops
+	if (backgroundThread.joinable())
+	{
+		lock.unlock();
+		backgroundThread.join();
+		lock.lock();
+	}
+
+	backgroundRunning = true;
+	backgroundThread = std::thread(&ShaderVariants::BackgroundLoop, this);
+
+	return true;
+}
+
+void ShaderVariants::BackgroundLoop()
+{
+	Profiler::SetThreadName("shader compiler");
+
+	if (!sharedContextWindow->makeSharedContextCurrent(true))
+	{
+		printf("Failed to bind the shared context, variants will compile on first use\n");
+
+		std::lock_guard<std::mutex> lock(variantMutex);
+		sharedContextWindow = NULL;
+		backgroundRunning = false;
+		return;
+	}
+
+	while (true)
+	{
+		ShaderFeatures features = 0;
+		bool reload = false;
+		{
+			std::lock_guard<std::mutex> lock(variantMutex);
+
+			// Get() may already have taken a queued variant for itself
+			while (!backgroundQueue.empty() && variants[backgroundQueue.front()].state != VARIANT_QUEUED)
+			{
+				backgroundQueue.pop_front();
+			}
+
+			// Cleared under the lock so a reload queued from now on starts a new thread
+			// (which joins this one, and so waits for the context to be released)
+			if (stopping || (backgroundQueue.empty() && reloadQueue.empty()))
+			{
+				backgroundRunning = false;
+				break;
+			}
+
+			if (!backgroundQueue.empty())
+			{
+				features = backgroundQueue.front();
+				backgroundQueue.pop_front();
+				variants[features].state = VARIANT_COMPILING;
+			}
+			else
+			{
+				features = reloadQueue.front();
+				reloadQueue.pop_front();
+				reload = true;
+			}
+		}
+
+		Shader* shader = Compile(features);
+
+		// The program has to be complete before another context uses it
+		glFinish();
+
+		std::lock_guard<std::mutex> lock(variantMutex);
+		if (reload)
+		{
+			finishedReloads.push_back({ features, shader });
+			continue;
+		}
+
+		FinishVariant(features, shader);
+	}
+
+	sharedContextWindow->makeSharedContextCurrent(false);
+}
+
+void ShaderVariants::CompileAll()
+{
+	for (ShaderFeatures features = 0; features < (1u << FEATURE_COUNT); features++)
+	{
+		if (IsValidFeatureSet(features))
+		{
+			Get(features);
+		}
+	}
+}
+
+void ShaderVariants::WaitForBackground()
+{
+	if (backgroundThread.joinable())
+	{
+		backgroundThread.join();
+	}
+}
+
+bool ShaderVariants::ReloadIfSource(const std::string& fileName)
+{
+	std::vector<ShaderFeatures> ready;
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		if (!vertexSource.DependsOn(fileName) && !fragmentSource.DependsOn(fileName))
+		{
+			return false;
+		}
+	}
+
+	PROFILE_ZONE("ShaderVariants::ReloadIfSource");
+
+	// Only the edited file is read again, the rest come from the file cache
+	ShaderSource newVertexSource, newFragmentSource;
+	if (!newVertexSource.LoadFromFile(vertexLocation.c_str()) || !newFragmentSource.LoadFromFile(fragmentLocation.c_str()))
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		vertexSource = newVertexSource;
+		fragmentSource = newFragmentSource;
+
+		for (std::unordered_map<ShaderFeatures, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+		{
+			if (it->second.state == VARIANT_READY)
+			{
+				ready.push_back(it->first);
+			}
+			else if (it->second.state == VARIANT_COMPILING)
+			{
+				// May already hold the old sources; rebuilt once it's done (queued ones read the new ones)
+				it->second.needsRebuild = true;
+			}
+		}
+	}
+
+	printf("Reloading %zu shader variant(s) after %s changed\n", ready.size(), fileName.c_str());
+
+	return StartRebuilds(ready);
+}
+
+bool ShaderVariants::StartRebuilds(const std::vector<ShaderFeatures>& features)
+{
+	ShaderSource newVertexSource, newFragmentSource;
+	Window* window;
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		newVertexSource = vertexSource;
+		newFragmentSource = fragmentSource;
+		window = sharedContextWindow; // cleared by the background thread if it can't use the context
+	}
+
+	if (GLEW_KHR_parallel_shader_compile || window == NULL)
+	{
+		// With the extension, BeginCompile returns as soon as the driver has the sources and
+		// PumpReloads picks the programs up once they report complete. Without it (and without
+		// a shared context) this is the same blocking compile a restart would do.
+		for (size_t i = 0; i < features.size(); i++)
+		{
+			std::string defines = GetFeatureDefines(features[i]);
+			ShaderSource vertCode = newVertexSource;
+			ShaderSource fragCode = newFragmentSource;
+			vertCode.InsertAfterVersion(defines);
+			fragCode.InsertAfterVersion(defines);
+
+			Shader* shader = new Shader();
+			shader->BeginCompile(vertCode, fragCode);
+			pendingReloads.push_back({ features[i], shader });
+		}
+
+		return true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		reloadQueue.insert(reloadQueue.end(), features.begin(), features.end());
+	}
+
+	return StartBackgroundThread();
+}
+
+void ShaderVariants::PumpReloads()
+{
+	std::vector<ShaderFeatures> stale;
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		stale.swap(staleVariants);
+	}
+
+	if (!stale.empty())
+	{
+		printf("Rebuilding %zu shader variant(s) compiled from the previous sources\n", stale.size());
+		StartRebuilds(stale);
+	}
+
+	std::vector<Reload> finished;
+
+	for (size_t i = 0; i < pendingReloads.size();)
+	{
+		if (pendingReloads[i].shader->IsCompileComplete())
+		{
+			pendingReloads[i].shader->FinishCompile();
+			finished.push_back(pendingReloads[i]);
+			pendingReloads.erase(pendingReloads.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(variantMutex);
+	finished.insert(finished.end(), finishedReloads.begin(), finishedReloads.end());
+	finishedReloads.clear();
+
+	for (size_t i = 0; i < finished.size(); i++)
+	{
+		Shader* rebuilt = finished[i].shader;
+
+		if (rebuilt->IsLinked())
+		{
+			// The old program ends up in rebuilt and is deleted with it
+			variants[finished[i].features].shader->SwapProgram(*rebuilt);
+		}
+		else
+		{
+			printf("Shader variant 0x%x failed to rebuild, keeping the previous program\n", finished[i].features);
+		}
+
+		delete rebuilt;
+	}
+}
+
+unsigned int ShaderVariants::GetReadyCount()
+{
+	std::lock_guard<std::mutex> lock(variantMutex);
+
+	unsigned int ready = 0;
+	for (std::unordered_map<ShaderFeatures, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+	{
+		if (it->second.state == VARIANT_READY)
+		{
+			ready++;
+		}
+	}
+
+	return ready;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	{
+		std::lock_guard<std::mutex> lock(variantMutex);
+		stopping = true;
+	}
+	WaitForBackground();
+
+	for (std::unordered_map<ShaderFeatures, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+	{
+		delete it->second.shader;
+	}
+
+	for (size_t i = 0; i < pendingReloads.size(); i++)
+	{
+		delete pendingReloads[i].shader;
+	}
+
+	for (size_t i = 0; i < finishedReloads.size(); i++)
+	{
+		delete finishedReloads[i].shader;
+	}
+}
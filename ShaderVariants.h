@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <GL/glew.h>
+
+#include "ShaderSource.h"
+
+class Shader;
+class Window;
+
+// Feature bits of a shader variant; each one turns into #defines in both stages
+typedef uint32_t ShaderFeatures;
+
+constexpr ShaderFeatures FEATURE_TEXTURE = 1 << 0;   // TEXTURE
+constexpr ShaderFeatures FEATURE_SPECULAR = 1 << 1;  // SPECULAR
+constexpr ShaderFeatures FEATURE_INSTANCED = 1 << 2; // INSTANCED
+constexpr ShaderFeatures FEATURE_LIGHTS_4 = 1 << 3;  // LIGHT_COUNT 4
+constexpr ShaderFeatures FEATURE_LIGHTS_16 = 1 << 4; // LIGHT_COUNT 16, exclusive with FEATURE_LIGHTS_4
+constexpr ShaderFeatures FEATURE_TEXTURE_ARRAY = 1 << 5; // TEXTURE_ARRAY, only with FEATURE_TEXTURE
+constexpr ShaderFeatures FEATURE_BATCHED = 1 << 6;   // BATCHED, exclusive with FEATURE_INSTANCED
+constexpr ShaderFeatures FEATURE_COUNT = 7;
+
+constexpr bool IsValidFeatureSet(ShaderFeatures features)
+{
+	return features < (1u << FEATURE_COUNT) && !((features & FEATURE_LIGHTS_4) && (features & FEATURE_LIGHTS_16)) &&
+		!((features & FEATURE_TEXTURE_ARRAY) && !(features & FEATURE_TEXTURE)) &&
+		!((features & FEATURE_BATCHED) && (features & FEATURE_INSTANCED));
+}
+
+// The #define block a feature set adds to the sources
+std::string GetFeatureDefines(ShaderFeatures features);
+
+// Every permutation of one vertex/fragment pair, compiled on demand
+//
+// Variants the frame needs are compiled on the calling thread by Get(). The rest can be handed to a
+// background thread with its own shared context, so switching to one later doesn't stall a frame.
+// Compiles go through Shader, so they also fill the program binary cache.
+class ShaderVariants
+{
+public:
+	ShaderVariants(const char* vertexLocation, const char* fragmentLocation);
+
+	// Blocks until the variant is ready: compiles it here, or waits if the background thread has it
+	Shader* Get(ShaderFeatures features);
+
+	// Queues every variant not compiled yet for a background thread on the window's shared context
+	bool CompileRemainingInBackground(Window* window);
+
+	// Compiles every variant on the calling thread (used to warm the binary cache)
+	void CompileAll();
+
+	// Blocks until the background thread has emptied its queue
+	void WaitForBackground();
+
+	unsigned int GetReadyCount();
+
+	// Hot reload: when fileName (no directory) is one of the two sources or a file they #include,
+	// re-reads them and rebuilds every ready variant without blocking the frame. Uses
+	// GL_KHR_parallel_shader_compile when the driver has it, else the background thread's shared
+	// context, else compiles right here.
+	// Returns true if a rebuild was started.
+	bool ReloadIfSource(const std::string& fileName);
+
+	// Call once per frame: swaps finished rebuilds into the existing Shader objects, so pointers
+	// handed out by Get() stay valid. A rebuild that fails to link is dropped and the old program stays.
+	// Also starts the rebuilds of variants that were mid-compile (on old sources) when a reload came in.
+	void PumpReloads();
+
+	~ShaderVariants();
+
+private:
+	enum VariantState
+	{
+		VARIANT_QUEUED,
+		VARIANT_COMPILING,
+		VARIANT_READY
+	};
+
+	struct Variant
+	{
+		Shader* shader;
+		VariantState state;
+		bool needsRebuild; // sources changed after this compile copied them
+	};
+
+	struct Reload
+	{
+		ShaderFeatures features;
+		Shader* shader;
+	};
+
+	std::string vertexLocation, fragmentLocation;
+	ShaderSource vertexSource, fragmentSource;
+
+	std::unordered_map<ShaderFeatures, Variant> variants;
+	std::deque<ShaderFeatures> backgroundQueue;
+
+	// Rebuilds the background thread still has to compile, and ones it has finished
+	std::deque<ShaderFeatures> reloadQueue;
+	std::vector<Reload> finishedReloads;
+
+	// Variants that finished compiling stale sources, rebuilt from PumpReloads
+	std::vector<ShaderFeatures> staleVariants;
+
+	// Rebuilds compiling in the driver's own threads, only touched by the main thread
+	std::vector<Reload> pendingReloads;
+
+	std::mutex variantMutex;
+	std::condition_variable variantReady;
+
+	std::thread backgroundThread;
+	Window* sharedContextWindow;
+	bool stopping;
+	bool backgroundRunning;
+
+	bool StartBackgroundThread();
+	Shader* Compile(ShaderFeatures features);
+	void FinishVariant(ShaderFeatures features, Shader* shader); // with variantMutex held
+	bool StartRebuilds(const std::vector<ShaderFeatures>& features);
+	void BackgroundLoop();
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+};
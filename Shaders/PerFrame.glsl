@@ -0,0 +1,20 @@
+// Per-frame data shared by every program, updated once a frame (see FrameUniforms.h)
+// Pulled in with #include "PerFrame.glsl" (resolved by ShaderSource, not the GLSL compiler)
+
+struct DirectionalLight 
+{
+	vec3 color;
+	float ambientIntensity;
+	vec3 direction;
+	float diffuseIntensity;
+};
+
+const int MAX_LIGHTS = 16; // must match MAX_LIGHTS in FrameUniforms.h
+
+layout (std140) uniform PerFrame
+{
+	mat4 projection;
+	mat4 view;
+	vec3 eyePosition;
+	DirectionalLight directionalLights[MAX_LIGHTS];
+};
@@ -0,0 +1,29 @@
+#version 330
+
+// Reference for --vertex-bench: default.vert as it was before the normal matrix moved to the CPU
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec2 tex;
+layout (location = 2) in vec3 norm;
+																
+out vec4 vCol;
+out vec2 outTexCoord;
+out vec3 Normal;
+out vec3 FragPos;
+
+uniform mat4 model;
+
+#include "PerFrame.glsl"
+
+
+void main()
+{
+   gl_Position = projection * view * model * vec4(pos, 1.0f);
+   vCol = vec4(clamp(pos, 0.0f, 1.0f), 1.0f);
+
+   outTexCoord = tex;
+
+   Normal = mat3(transpose(inverse(model))) * norm;
+
+   FragPos = (model * vec4(pos, 1.0f)).xyz; // Swizzling - accessing the xyz components of vectors
+}
\ No newline at end of file
@@ -1,5 +1,15 @@
 #version 330
 
+// Variants are built by ShaderVariants, which adds the feature #defines below the version line
+//   TEXTURE        modulate the lighting by texture1 instead of the vertex color
+//   TEXTURE_ARRAY  texture1 is a texture array and textureLayer picks this draw's image (with TEXTURE)
+//   SPECULAR       add specular highlights from the material
+//   LIGHT_COUNT n  number of directional lights to sum (1 when not defined)
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
 in vec4 vCol;
 in vec2 outTexCoord;
 in vec3 Normal;
@@ -7,13 +17,7 @@ in vec3 FragPos;
 
 out vec4 fragColor;
 
-struct DirectionalLight 
-{
-	vec3 color;
-	float ambientIntensity;
-	vec3 direction;
-	float diffuseIntensity;
-};
+#include "PerFrame.glsl"
 
 struct Material
 {
@@ -21,32 +25,53 @@ struct Material
 	float shininess;
 };
 
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray texture1;
+uniform int textureLayer;
+#else
 uniform sampler2D texture1;
-uniform DirectionalLight directionalLight;
+#endif
 uniform Material material;
 
-uniform vec3 eyePosition;
-
-void main()
+vec4 CalcDirectionalLight(DirectionalLight light)
 {
-	vec4 ambientColor = vec4(directionalLight.color, 1.0f) * directionalLight.ambientIntensity;
+	vec4 ambientColor = vec4(light.color, 1.0f) * light.ambientIntensity;
 	
-	float diffuseFactor = max(dot(normalize(Normal), normalize(directionalLight.direction)), 0.0f);
-	vec4 diffuseColor = vec4(directionalLight.color, 1.0f) * directionalLight.diffuseIntensity * diffuseFactor;
+	float diffuseFactor = max(dot(normalize(Normal), normalize(light.direction)), 0.0f);
+	vec4 diffuseColor = vec4(light.color, 1.0f) * light.diffuseIntensity * diffuseFactor;
 
 	vec4 specularColor = vec4(0, 0, 0, 0);
 
+#ifdef SPECULAR
 	if (diffuseFactor > 0.0f)
 	{
 		vec3 fragToEye = normalize(eyePosition - FragPos);
-		vec3 reflectedVertex = normalize(reflect(directionalLight.direction, normalize(Normal)));
+		vec3 reflectedVertex = normalize(reflect(light.direction, normalize(Normal)));
 		float specularFactor = dot(fragToEye, reflectedVertex);
 		if (specularFactor > 0.0f)
 		{
 			specularFactor = pow(specularFactor, material.shininess);
-			specularColor = vec4(directionalLight.color * material.specularIntensity * specularFactor, 1.0f);
+			specularColor = vec4(light.color * material.specularIntensity * specularFactor, 1.0f);
 		}
 	}
+#endif
+
+	return ambientColor + diffuseColor + specularColor;
+}
+
+void main()
+{
+	vec4 lightColor = vec4(0, 0, 0, 0);
+	for (int i = 0; i < LIGHT_COUNT; i++)
+	{
+		lightColor += CalcDirectionalLight(directionalLights[i]);
+	}
 
-	fragColor = texture(texture1, outTexCoord) * (ambientColor + diffuseColor + specularColor);
+#if defined(TEXTURE_ARRAY)
+	fragColor = texture(texture1, vec3(outTexCoord, textureLayer)) * lightColor;
+#elif defined(TEXTURE)
+	fragColor = texture(texture1, outTexCoord) * lightColor;
+#else
+	fragColor = vCol * lightColor;
+#endif
 }
\ No newline at end of file
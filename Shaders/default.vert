@@ -1,5 +1,14 @@
 #version 330
 
+#if defined(BATCHED) && defined(GL_ARB_shader_draw_parameters)
+#extension GL_ARB_shader_draw_parameters : enable
+#endif
+
+// Variants are built by ShaderVariants, which adds the feature #defines below the version line
+//   INSTANCED    model and normal matrix come from per-instance attributes instead of uniforms
+//   BATCHED      model and normal matrix come from the objectTransforms buffer, at batchBase plus the
+//                draw's index within a multi-draw (see StaticBatch.h)
+
 layout (location = 0) in vec3 pos;
 layout (location = 1) in vec2 tex;
 layout (location = 2) in vec3 norm;
@@ -9,19 +18,47 @@ out vec2 outTexCoord;
 out vec3 Normal;
 out vec3 FragPos;
 
+#ifdef INSTANCED
+layout (location = 3) in mat4 instanceModel; // per instance, locations 3-6
+layout (location = 7) in mat3 instanceNormalMatrix; // per instance, locations 7-9
+#elif defined(BATCHED)
+uniform samplerBuffer objectTransforms; // 7 texels per object: model columns, then normal matrix columns
+uniform int batchBase;
+#ifdef GL_ARB_shader_draw_parameters
+#define DRAW_ID gl_DrawIDARB
+#else
+#define DRAW_ID 0 // the batch falls back to one draw per object, setting batchBase for each
+#endif
+#else
 uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+uniform mat3 normalMatrix; // inverse transpose of model, computed on the CPU per draw
+#endif
+
+#include "PerFrame.glsl"
 
 
 void main()
 {
-   gl_Position = projection * view * model * vec4(pos, 1.0f);
+#ifdef INSTANCED
+   mat4 modelMatrix = instanceModel;
+   mat3 normalTransform = instanceNormalMatrix;
+#elif defined(BATCHED)
+   int object = (batchBase + DRAW_ID) * 7;
+   mat4 modelMatrix = mat4(texelFetch(objectTransforms, object), texelFetch(objectTransforms, object + 1),
+      texelFetch(objectTransforms, object + 2), texelFetch(objectTransforms, object + 3));
+   mat3 normalTransform = mat3(texelFetch(objectTransforms, object + 4).xyz, texelFetch(objectTransforms, object + 5).xyz,
+      texelFetch(objectTransforms, object + 6).xyz);
+#else
+   mat4 modelMatrix = model;
+   mat3 normalTransform = normalMatrix;
+#endif
+
+   gl_Position = projection * view * modelMatrix * vec4(pos, 1.0f);
    vCol = vec4(clamp(pos, 0.0f, 1.0f), 1.0f);
 
    outTexCoord = tex;
 
-   Normal = mat3(transpose(inverse(model))) * norm;
+   Normal = normalTransform * norm;
 
-   FragPos = (model * vec4(pos, 1.0f)).xyz; // Swizzling - accessing the xyz components of vectors
+   FragPos = (modelMatrix * vec4(pos, 1.0f)).xyz; // Swizzling - accessing the xyz components of vectors
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "StaticBatch.h"
+
+#include <stdio.h>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "NormalMatrix.h"
+#include "GLState.h"
+
+StaticBatch::StaticBatch()
+{
+	vertexArray = 0;
+	indexType = GL_UNSIGNED_SHORT;
+	path = BATCH_PATH_PER_DRAW;
+
+	commandBuffer = 0;
+}
+
+bool StaticBatch::AddObject(Mesh* mesh, const glm::mat4& transform)
+{
+	if (!meshes.empty() && (mesh->GetVertexArray(false) != vertexArray || mesh->GetIndexType() != indexType))
+	{
+		printf("Static batch objects must share a geometry arena, leaving one out\n");
+		return false;
+	}
+
+	vertexArray = mesh->GetVertexArray(false);
+	indexType = mesh->GetIndexType();
+
+	meshes.push_back(mesh);
+	transforms.push_back(transform);
+	return true;
+}
+
+BatchPath StaticBatch::GetBestPath()
+{
+	// Both multi-draw paths rely on gl_DrawIDARB to tell the objects apart
+	if (!GLEW_ARB_shader_draw_parameters)
+	{
+		return BATCH_PATH_PER_DRAW;
+	}
+
+	if (GLEW_ARB_multi_draw_indirect && GLEW_ARB_draw_indirect)
+	{
+		return BATCH_PATH_INDIRECT;
+	}
+
+	return BATCH_PATH_MULTI_DRAW;
+}
+
+const char* StaticBatch::GetPathName(BatchPath path)
+{
+	switch (path)
+	{
+	case BATCH_PATH_INDIRECT:
+		return "multi-draw indirect";
+	case BATCH_PATH_MULTI_DRAW:
+		return "multi-draw";
+	default:
+		return "per-draw";
+	}
+}
+
+void StaticBatch::BuildBatch(BatchPath requestedPath)
+{
+	ReleaseBuffers();
+
+	BatchPath bestPath = GetBestPath();
+	path = requestedPath > bestPath ? requestedPath : bestPath;
+
+	GLsizei objectCount = (GLsizei)meshes.size();
+	if (objectCount == 0)
+	{
+		return;
+	}
+
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	GLsizei chunkObjects = maxTexels / (GLint)OBJECT_TRANSFORM_TEXELS;
+	if (chunkObjects == 0)
+	{
+		printf("Texture buffers of %d texels can't hold an object transform, batch left empty\n", maxTexels);
+		return;
+	}
+
+	// Quantized meshes are taken back to model space here, the normal matrix stays that of the object
+	std::vector<glm::vec4> texels((size_t)objectCount * OBJECT_TRANSFORM_TEXELS);
+	for (GLsizei i = 0; i < objectCount; i++)
+	{
+		glm::mat4 model = transforms[i] * meshes[i]->GetDequantization();
+		glm::mat3 normalMatrix = CalculateNormalMatrix(transforms[i]);
+
+		glm::vec4* object = &texels[(size_t)i * OBJECT_TRANSFORM_TEXELS];
+		for (int column = 0; column < 4; column++)
+		{
+			object[column] = model[column];
+		}
+		for (int column = 0; column < 3; column++)
+		{
+			object[4 + column] = glm::vec4(normalMatrix[column], 0.0f);
+		}
+	}
+
+	for (GLsizei first = 0; first < objectCount; first += chunkObjects)
+	{
+		TransformChunk chunk;
+		chunk.firstObject = first;
+		chunk.objectCount = objectCount - first < chunkObjects ? objectCount - first : chunkObjects;
+
+		glGenBuffers(1, &chunk.buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, chunk.buffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * OBJECT_TRANSFORM_TEXELS * chunk.objectCount,
+			&texels[(size_t)first * OBJECT_TRANSFORM_TEXELS], GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenTextures(1, &chunk.texture);
+		GLState::BindTexture(0, GL_TEXTURE_BUFFER, chunk.texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, chunk.buffer);
+		GLState::BindTexture(0, GL_TEXTURE_BUFFER, 0);
+
+		chunks.push_back(chunk);
+	}
+
+	GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+	if (path == BATCH_PATH_INDIRECT)
+	{
+		std::vector<DrawElementsCommand> commands(objectCount);
+		for (GLsizei i = 0; i < objectCount; i++)
+		{
+			commands[i].count = (GLuint)meshes[i]->GetIndexCount();
+			commands[i].instanceCount = 1;
+			commands[i].firstIndex = meshes[i]->GetFirstIndex();
+			commands[i].baseVertex = meshes[i]->GetBaseVertex();
+			commands[i].baseInstance = 0;
+		}
+
+		glGenBuffers(1, &commandBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsCommand) * commands.size(), commands.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else
+	{
+		counts.resize(objectCount);
+		indexOffsets.resize(objectCount);
+		baseVertices.resize(objectCount);
+		for (GLsizei i = 0; i < objectCount; i++)
+		{
+			counts[i] = meshes[i]->GetIndexCount();
+			indexOffsets[i] = (const void*)(indexSize * meshes[i]->GetFirstIndex());
+			baseVertices[i] = meshes[i]->GetBaseVertex();
+		}
+	}
+}
+
+void StaticBatch::DrawBatch(Shader* shader)
+{
+	constexpr uint64_t OBJECT_TRANSFORMS = UniformName("objectTransforms");
+	constexpr uint64_t BATCH_BASE = UniformName("batchBase");
+
+	if (chunks.empty())
+	{
+		return;
+	}
+
+	// Cached by the shader, so only the first batch drawn with it sets the unit
+	shader->Set(OBJECT_TRANSFORMS, (GLint)OBJECT_TRANSFORM_UNIT);
+
+	if (path == BATCH_PATH_INDIRECT)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	}
+
+	// gl_DrawIDARB restarts at 0 with every call, and each chunk's transforms start at texel 0
+	for (const TransformChunk& chunk : chunks)
+	{
+		GLsizei first = chunk.firstObject;
+		GLState::BindTexture(OBJECT_TRANSFORM_UNIT, GL_TEXTURE_BUFFER, chunk.texture);
+
+		switch (path)
+		{
+		case BATCH_PATH_INDIRECT:
+			shader->Set(BATCH_BASE, (GLint)0);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)(sizeof(DrawElementsCommand) * first), chunk.objectCount, 0);
+			break;
+		case BATCH_PATH_MULTI_DRAW:
+			shader->Set(BATCH_BASE, (GLint)0);
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, &counts[first], indexType, &indexOffsets[first], chunk.objectCount, &baseVertices[first]);
+			break;
+		default:
+			// gl_DrawIDARB is 0 for single draws, so batchBase alone picks the object
+			for (GLsizei i = 0; i < chunk.objectCount; i++)
+			{
+				shader->Set(BATCH_BASE, (GLint)i);
+				glDrawElementsBaseVertex(GL_TRIANGLES, counts[first + i], indexType, indexOffsets[first + i], baseVertices[first + i]);
+			}
+			break;
+		}
+	}
+
+	if (path == BATCH_PATH_INDIRECT)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void StaticBatch::ReleaseBuffers()
+{
+	if (commandBuffer != 0)
+	{
+		glDeleteBuffers(1, &commandBuffer);
+		commandBuffer = 0;
+	}
+
+	for (const TransformChunk& chunk : chunks)
+	{
+		GLState::ForgetTexture(chunk.texture);
+		glDeleteTextures(1, &chunk.texture);
+		glDeleteBuffers(1, &chunk.buffer);
+	}
+	chunks.clear();
+
+	counts.clear();
+	indexOffsets.clear();
+	baseVertices.clear();
+}
+
+void StaticBatch::ClearBatch()
+{
+	ReleaseBuffers();
+
+	meshes.clear();
+	transforms.clear();
+	vertexArray = 0;
+}
+
+StaticBatch::~StaticBatch()
+{
+	ClearBatch();
+}
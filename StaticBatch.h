@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class Mesh;
+class Shader;
+
+// How a StaticBatch issues its draws, fastest first
+enum BatchPath
+{
+	BATCH_PATH_INDIRECT,   // one glMultiDrawElementsIndirect from a buffer of draw commands
+	BATCH_PATH_MULTI_DRAW, // one glMultiDrawElementsBaseVertex from client arrays
+	BATCH_PATH_PER_DRAW    // glDrawElementsBaseVertex per object, setting only batchBase in between
+};
+
+// Texture unit the BATCHED shader variant reads objectTransforms from
+const GLuint OBJECT_TRANSFORM_UNIT = 1;
+
+// Texels (RGBA32F) per object in the transform buffer: 4 model matrix columns, then 3 normal matrix columns
+const GLuint OBJECT_TRANSFORM_TEXELS = 7;
+
+// Objects that never move and share one shader, texture and material, drawn with a single call
+//
+// Every mesh must live in the same GeometryArena, so the batch needs one VAO. The per-object model
+// and normal matrices are uploaded once into a texture buffer. The BATCHED shader variant reads them
+// at batchBase + gl_DrawIDARB, so the multi-draw paths need ARB_shader_draw_parameters; without it
+// every object is drawn on its own with batchBase set to its index. Objects aren't culled individually.
+//
+// GL 3.3 only promises 65536 texels per texture buffer, so past GL_MAX_TEXTURE_BUFFER_SIZE / 7 objects
+// the transforms are split over several buffers and the batch takes one call per buffer.
+class StaticBatch
+{
+public:
+	StaticBatch();
+
+	// False (and the object is left out) when the mesh isn't in the same arena as the ones before it
+	bool AddObject(Mesh* mesh, const glm::mat4& transform);
+
+	// Uploads the transforms and draw commands, replacing those of an earlier build; path is lowered
+	// to the best one the driver supports
+	void BuildBatch(BatchPath path);
+
+	// With the batch's VAO bound and shader in use
+	void DrawBatch(Shader* shader);
+
+	static BatchPath GetBestPath();
+	static const char* GetPathName(BatchPath path);
+
+	BatchPath GetPath() { return path; }
+	GLuint GetVertexArray() { return vertexArray; }
+	GLsizei GetObjectCount() { return (GLsizei)meshes.size(); }
+
+	void ClearBatch();
+
+	~StaticBatch();
+
+private:
+	// Matches the layout glMultiDrawElementsIndirect reads
+	struct DrawElementsCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	std::vector<Mesh*> meshes;
+	std::vector<glm::mat4> transforms;
+	GLuint vertexArray;
+	GLenum indexType;
+	BatchPath path;
+
+	// The objects from firstObject on whose transforms one texture buffer holds
+	struct TransformChunk
+	{
+		GLuint buffer;
+		GLuint texture;
+		GLsizei firstObject;
+		GLsizei objectCount;
+	};
+
+	std::vector<TransformChunk> chunks;
+	GLuint commandBuffer;
+
+	// Client-side arguments for the multi-draw and per-draw paths
+	std::vector<GLsizei> counts;
+	std::vector<const void*> indexOffsets;
+	std::vector<GLint> baseVertices;
+
+	// Drops what BuildBatch made but keeps the objects
+	void ReleaseBuffers();
+
+	StaticBatch(const StaticBatch&) = delete;
+	StaticBatch& operator=(const StaticBatch&) = delete;
+};
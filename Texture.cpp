@@ -1,4 +1,9 @@
 #include "Texture.h"
+#include "Profiler.h"
+#include "GLState.h"
+
+#include <string.h>
+#include <utility>
 
 Texture::Texture()
 {
@@ -6,6 +11,18 @@ Texture::Texture()
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	residentBytes = 0;
+	levelCount = 0;
+	pixels = NULL;
+	filter = TEXTURE_FILTER_TRILINEAR;
+	anisotropy = 1.0f;
+	wrapMode = GL_REPEAT;
+	cpuMipmaps = false;
+	array = NULL;
+	arrayLayer = -1;
+	ownsArrayLayer = false;
+	uploadRing = NULL;
+	ringAllocation = PixelUploadRing::Allocation();
 	fileLocation = "";
 }
 
@@ -15,60 +32,370 @@ Texture::Texture(const char* fileLoc)
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	residentBytes = 0;
+	levelCount = 0;
+	pixels = NULL;
+	filter = TEXTURE_FILTER_TRILINEAR;
+	anisotropy = 1.0f;
+	wrapMode = GL_REPEAT;
+	cpuMipmaps = false;
+	array = NULL;
+	arrayLayer = -1;
+	ownsArrayLayer = false;
+	uploadRing = NULL;
+	ringAllocation = PixelUploadRing::Allocation();
 	fileLocation = fileLoc;
 }
 
 void Texture::LoadTexture()
 {
-	stbi_set_flip_vertically_on_load(true);
+	PROFILE_ZONE("Texture::LoadTexture");
+
+	if (DecodeTexture())
+	{
+		UploadTexture();
+	}
+}
+
+bool Texture::DecodeTexture()
+{
+	PROFILE_ZONE("Texture::DecodeTexture");
 
-	unsigned char* textureData = stbi_load(fileLocation, &width, &height, &bitDepth, 4); // use STBI_rgb_alpha if 0, 3, or 4 causes the program to crash
-	if (!textureData)
+	if (IsCompressedImageFile(fileLocation))
+	{
+		return LoadCompressedImage(fileLocation, compressed);
+	}
+
+	// The thread-local flag keeps concurrent decodes from racing on stb_image's global setting
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	pixels = stbi_load(fileLocation, &width, &height, &bitDepth, 4); // use STBI_rgb_alpha if 0, 3, or 4 causes the program to crash
+	if (!pixels)
 	{
 		printf("Failed to find: %s\n", fileLocation);
+		return false;
+	}
+
+	if (array != NULL)
+	{
+		if (width != array->GetLayerWidth() || height != array->GetLayerHeight())
+		{
+			PROFILE_ZONE("ResampleRGBA8");
+			layerPixels.resize((size_t)array->GetLayerWidth() * array->GetLayerHeight() * 4);
+			ResampleRGBA8(pixels, width, height, layerPixels.data(), array->GetLayerWidth(), array->GetLayerHeight());
+
+			stbi_image_free(pixels);
+			pixels = layerPixels.data();
+			width = array->GetLayerWidth();
+			height = array->GetLayerHeight();
+		}
+	}
+
+	if (cpuMipmaps || array != NULL || uploadRing != NULL)
+	{
+		PROFILE_ZONE("BuildMipChain");
+		BuildMipChain(pixels, width, height, mipChain);
+	}
+
+	if (uploadRing != NULL)
+	{
+		CopyToUploadRing();
+	}
+
+	return true;
+}
+
+void Texture::CopyToUploadRing()
+{
+	size_t imageBytes = (size_t)width * height * 4;
+	if (!uploadRing->Allocate(imageBytes + mipChain.data.size(), ringAllocation))
+	{
+		return; // full, the upload reads pixels as usual
+	}
+
+	PROFILE_ZONE("Texture::CopyToUploadRing");
+
+	// Sequential writes only: the mapping is write-combined on most drivers
+	memcpy(ringAllocation.data, pixels, imageBytes);
+	if (!mipChain.data.empty())
+	{
+		memcpy(ringAllocation.data + imageBytes, mipChain.data.data(), mipChain.data.size());
+	}
+
+	// The level sizes are still needed for the upload, the pixels aren't
+	FreePixels();
+	mipChain.data = std::vector<unsigned char>();
+}
+
+void Texture::UploadTexture()
+{
+	PROFILE_ZONE("Texture::UploadTexture");
+
+	if (!compressed.levels.empty())
+	{
+		UploadCompressed();
 		return;
 	}
 
+	if (!pixels && ringAllocation.data == NULL)
+	{
+		return;
+	}
+
+	// Level 0 then the mips, read from the upload ring when the decode got space in it
+	const unsigned char* source = pixels;
+	const unsigned char* mipSource = mipChain.data.data();
+	if (ringAllocation.data != NULL)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadRing->GetBufferID());
+		source = (const unsigned char*)(uintptr_t)ringAllocation.offset; // offsets into the bound buffer
+		mipSource = source + (size_t)width * height * 4;
+	}
+
+	if (array != NULL)
+	{
+		array->UploadLayer(arrayLayer, source, mipChain.levels, mipSource);
+
+		// The share of the array this layer takes
+		residentBytes = (size_t)width * height * 4 + GetMipChainSize(mipChain);
+		levelCount = 1 + (GLint)mipChain.levels.size();
+	}
+	else
+	{
+		UploadImage(source, mipSource);
+	}
+
+	// The GPU may still be reading the ring; the fence keeps the region from being reused until it's done
+	if (ringAllocation.data != NULL)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		uploadRing->Release(ringAllocation, true);
+		ringAllocation = PixelUploadRing::Allocation();
+	}
+
+	// Free up the texture data
+	FreePixels();
+	mipChain = MipChain();
+}
+
+void Texture::UploadImage(const unsigned char* source, const unsigned char* mipSource)
+{
 	//unsigned int textureID;
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
 
+	residentBytes = (size_t)width * height * 4;
+	levelCount = 1;
 
-	// Set the texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// From the ring, into immutable storage made for every level up front
+	if (ringAllocation.data != NULL && GLEW_ARB_texture_storage)
+	{
+		levelCount += (GLint)mipChain.levels.size();
+		glTexStorage2D(GL_TEXTURE_2D, levelCount, GL_RGBA8, width, height);
 
-	// Set the texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, source);
+		for (size_t level = 0; level < mipChain.levels.size(); level++)
+		{
+			const MipLevel& entry = mipChain.levels[level];
+			glTexSubImage2D(GL_TEXTURE_2D, (GLint)level + 1, 0, 0, entry.width, entry.height, GL_RGBA, GL_UNSIGNED_BYTE, mipSource + entry.offset);
+		}
+		residentBytes += GetMipChainSize(mipChain);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, source);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, textureData);
-	glGenerateMipmap(GL_TEXTURE_2D);
+		// Mips from the decode thread when it built them, otherwise from the driver (which stalls this thread)
+		if (!mipChain.levels.empty())
+		{
+			for (size_t level = 0; level < mipChain.levels.size(); level++)
+			{
+				const MipLevel& entry = mipChain.levels[level];
+				glTexImage2D(GL_TEXTURE_2D, (GLint)level + 1, GL_RGBA, entry.width, entry.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mipSource + entry.offset);
+			}
+			residentBytes += GetMipChainSize(mipChain);
+			levelCount += (GLint)mipChain.levels.size();
+		}
+		else
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
 
+			// Every level down to 1x1, the same sizes BuildMipChain makes
+			for (int levelWidth = width, levelHeight = height; levelWidth > 1 || levelHeight > 1;)
+			{
+				levelWidth = GetNextMipSize(levelWidth);
+				levelHeight = GetNextMipSize(levelHeight);
+				residentBytes += (size_t)levelWidth * levelHeight * 4;
+				levelCount++;
+			}
+		}
+	}
 
-	// Free up the texture data
-	stbi_image_free(textureData);
+	ApplySampling();
 
 	// Unbind the texture
-	glBindTexture(GL_TEXTURE_2D,0);
+	GLState::BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void Texture::UploadCompressed()
+{
+	if (!IsCompressedFormatSupported(compressed.format))
+	{
+		printf("%s: this driver can't sample %s textures\n", fileLocation, GetCompressedFormatName(compressed.format));
+		compressed = CompressedImage();
+		return;
+	}
+
+	glGenTextures(1, &textureID);
+	GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
+
+	// The file brings its own mips (the driver can't generate them for these formats)
+	levelCount = (GLint)compressed.levels.size();
+	ApplySampling();
+
+	residentBytes = 0;
+	for (size_t level = 0; level < compressed.levels.size(); level++)
+	{
+		const CompressedLevel& entry = compressed.levels[level];
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, compressed.format, entry.width, entry.height, 0,
+			(GLsizei)entry.size, &compressed.data[entry.offset]);
+		residentBytes += entry.size;
+	}
+
+	width = compressed.width;
+	height = compressed.height;
+	compressed = CompressedImage();
+
+	GLState::BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void Texture::CopySettings(const Texture& other)
+{
+	filter = other.filter;
+	anisotropy = other.anisotropy;
+	wrapMode = other.wrapMode;
+	cpuMipmaps = other.cpuMipmaps;
+	array = other.array;
+	arrayLayer = other.arrayLayer;
+	ownsArrayLayer = false; // the replacement refills other's layer, which other still gives back
+	uploadRing = other.uploadRing;
+}
+
+void Texture::SwapTexture(Texture& other)
+{
+	std::swap(textureID, other.textureID);
+	std::swap(width, other.width);
+	std::swap(height, other.height);
+	std::swap(bitDepth, other.bitDepth);
+	std::swap(residentBytes, other.residentBytes);
+	std::swap(levelCount, other.levelCount);
+}
+
+void Texture::SetArrayLayer(TextureArray* array, int layer)
+{
+	this->array = array;
+	arrayLayer = layer;
+	ownsArrayLayer = true;
+}
 
+void Texture::SetSampling(TextureFilter filter, GLfloat anisotropy, GLenum wrapMode)
+{
+	this->filter = filter;
+	this->anisotropy = anisotropy;
+	this->wrapMode = wrapMode;
+
+	if (textureID != 0)
+	{
+		GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
+		ApplySampling();
+		GLState::BindTexture(0, GL_TEXTURE_2D, 0);
+	}
+}
+
+void Texture::ApplySampling()
+{
+	ApplyTextureSampling(GL_TEXTURE_2D, levelCount, filter, anisotropy, wrapMode);
+}
+
+bool Texture::IsCompressedFormatSupported(GLenum format)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return GLEW_EXT_texture_compression_s3tc;
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return GLEW_ARB_texture_compression_bptc;
+	case GL_COMPRESSED_RGB8_ETC2:
+	case GL_COMPRESSED_SRGB8_ETC2:
+	case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+	case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+	case GL_COMPRESSED_RGBA8_ETC2_EAC:
+	case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+		return GLEW_ARB_ES3_compatibility;
+	default:
+		return false;
+	}
 }
 
 void Texture::UseTexture()
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	if (array != NULL)
+	{
+		array->UseTextureArray();
+		return;
+	}
+
+	GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
+}
+
+void Texture::FreePixels()
+{
+	if (pixels != NULL && pixels != layerPixels.data())
+	{
+		stbi_image_free(pixels);
+	}
+
+	pixels = NULL;
+	layerPixels = std::vector<unsigned char>();
 }
 
 void Texture::ClearTexture()
 {
+	GLState::ForgetTexture(textureID);
 	glDeleteTextures(1, &textureID);
 	textureID = 0;
 	width = 0;
 	height = 0;
 	bitDepth = 0;
+	residentBytes = 0;
+	levelCount = 0;
 	fileLocation = "";
+
+	if (array != NULL && ownsArrayLayer)
+	{
+		array->ReleaseLayer(arrayLayer);
+	}
+	array = NULL;
+	arrayLayer = -1;
+	ownsArrayLayer = false;
+
+	FreePixels();
+	compressed = CompressedImage();
+	mipChain = MipChain();
+
+	// Decoded but never uploaded: nothing read the region, so it's free right away
+	if (uploadRing != NULL)
+	{
+		uploadRing->Release(ringAllocation, false);
+		ringAllocation = PixelUploadRing::Allocation();
+	}
 }
 
 Texture::~Texture()
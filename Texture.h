@@ -1,5 +1,10 @@
 #include <GL/glew.h>
 #include "stb_image.h"
+#include "CompressedImage.h"
+#include "MipChain.h"
+#include "TextureSampling.h"
+#include "TextureArray.h"
+#include "PixelUploadRing.h"
 
 
 class Texture
@@ -9,8 +14,48 @@ public:
 
 	Texture(const char* fileLoc);
 
+	// LoadTexture() = DecodeTexture() + UploadTexture()
+	// DecodeTexture() touches no GL state, so it can run on a worker thread
+	// .ktx2 and .dds files are uploaded as they are stored (block-compressed, with their own mips);
+	// anything else is decoded to RGBA8 by stb_image
 	void LoadTexture();
+	bool DecodeTexture();
+	void UploadTexture();
+
 	void UseTexture();
+
+	// Defaults to trilinear, no anisotropy, GL_REPEAT. Anisotropy is clamped to what the driver
+	// supports (ignored without the extension). Applied at upload, or straight away if already uploaded.
+	// A texture packed into an array samples however the array does.
+	void SetSampling(TextureFilter filter, GLfloat anisotropy, GLenum wrapMode);
+
+	// Build the RGBA8 mip chain in DecodeTexture() instead of glGenerateMipmap() in UploadTexture(),
+	// so the work happens on the decode thread; set before decoding
+	void SetCpuMipmaps(bool enabled) { cpuMipmaps = enabled; }
+
+	// Upload into a layer of array (resized to its layer size, mips built on the CPU) instead of a
+	// texture of its own; set before decoding. Only for images stb_image decodes. The layer is given
+	// back to the array when the texture is cleared.
+	void SetArrayLayer(TextureArray* array, int layer);
+	int GetArrayLayer() { return arrayLayer; } // -1 when not packed
+
+	// Decode into ring (mips built on the CPU) and upload from there when it has room; set before decoding
+	void SetUploadRing(PixelUploadRing* ring) { uploadRing = ring; }
+
+	// Everything set above, for a texture that will replace this one; the layer stays other's to give back
+	void CopySettings(const Texture& other);
+
+	// Trades uploaded images with other (for reloads: users of this object see the new image)
+	void SwapTexture(Texture& other);
+
+	// Whether the driver can sample a GL_COMPRESSED_* format (GL thread only)
+	static bool IsCompressedFormatSupported(GLenum format);
+
+	// The array's texture when packed, so draws sharing it sort together
+	GLuint GetTextureID() { return array != NULL ? array->GetTextureID() : textureID; }
+
+	// GL memory of the uploaded image and its mip chain, 0 before the upload
+	size_t GetResidentBytes() { return residentBytes; }
 	void ClearTexture();
 
 	~Texture();
@@ -18,6 +63,31 @@ public:
 private:
 	GLuint textureID;
 	int width, height, bitDepth;
+	size_t residentBytes;
+	GLint levelCount; // uploaded mip levels
+
+	unsigned char* pixels; // decoded RGBA8, only held between decode and upload
+	CompressedImage compressed; // or the compressed file, likewise
+	MipChain mipChain; // levels below pixels when built on the CPU
+	std::vector<unsigned char> layerPixels; // pixels resized to the array's layer size, when they differ
+
+	TextureArray* array;
+	int arrayLayer;
+	bool ownsArrayLayer; // false for a Reload replacement sharing the live texture's layer
+
+	PixelUploadRing* uploadRing;
+	PixelUploadRing::Allocation ringAllocation; // level 0 then the mips, between decode and upload
+
+	TextureFilter filter;
+	GLfloat anisotropy;
+	GLenum wrapMode;
+	bool cpuMipmaps;
+
+	void CopyToUploadRing();
+	void UploadImage(const unsigned char* source, const unsigned char* mipSource);
+	void UploadCompressed();
+	void ApplySampling();
+	void FreePixels();
 
 	const char* fileLocation;
 };
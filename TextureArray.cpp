@@ -0,0 +1,170 @@
+#include "TextureArray.h"
+#include "Profiler.h"
+#include "GLState.h"
+
+#include <stdio.h>
+
+TextureArray::TextureArray()
+{
+	textureID = 0;
+	layerWidth = 0;
+	layerHeight = 0;
+	layerCapacity = 0;
+	layerCount = 0;
+	levelCount = 0;
+	filter = TEXTURE_FILTER_TRILINEAR;
+	anisotropy = 1.0f;
+	wrapMode = GL_REPEAT;
+}
+
+TextureArray::TextureArray(int layerWidth, int layerHeight, int layerCapacity)
+{
+	textureID = 0;
+	this->layerWidth = layerWidth;
+	this->layerHeight = layerHeight;
+	this->layerCapacity = layerCapacity;
+	layerCount = 0;
+	levelCount = 0;
+	filter = TEXTURE_FILTER_TRILINEAR;
+	anisotropy = 1.0f;
+	wrapMode = GL_REPEAT;
+}
+
+int TextureArray::ReserveLayer()
+{
+	if (!freeLayers.empty())
+	{
+		int layer = freeLayers.back();
+		freeLayers.pop_back();
+		return layer;
+	}
+
+	if (layerCount >= layerCapacity)
+	{
+		return -1;
+	}
+
+	return layerCount++;
+}
+
+void TextureArray::ReleaseLayer(int layer)
+{
+	if (layer < 0 || layer >= layerCount)
+	{
+		printf("Texture array layer %d was never reserved (%d reserved)\n", layer, layerCount);
+		return;
+	}
+
+	freeLayers.push_back(layer);
+}
+
+void TextureArray::CreateStorage()
+{
+	PROFILE_ZONE("TextureArray::CreateStorage");
+
+	glGenTextures(1, &textureID);
+	GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, textureID);
+
+	// Every level down to 1x1, the same sizes BuildMipChain makes; layers are filled in as they arrive
+	levelCount = 0;
+	for (int levelWidth = layerWidth, levelHeight = layerHeight; ; levelCount++)
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, levelCount, GL_RGBA8, levelWidth, levelHeight, layerCapacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			levelCount++;
+			break;
+		}
+
+		levelWidth = GetNextMipSize(levelWidth);
+		levelHeight = GetNextMipSize(levelHeight);
+	}
+
+	ApplyTextureSampling(GL_TEXTURE_2D_ARRAY, levelCount, filter, anisotropy, wrapMode);
+}
+
+void TextureArray::UploadLayer(int layer, const unsigned char* pixels, const std::vector<MipLevel>& levels, const unsigned char* levelData)
+{
+	PROFILE_ZONE("TextureArray::UploadLayer");
+
+	if (layer < 0 || layer >= layerCapacity)
+	{
+		printf("Texture array layer %d out of range (%d layers)\n", layer, layerCapacity);
+		return;
+	}
+
+	if (textureID == 0)
+	{
+		CreateStorage();
+	}
+	else
+	{
+		GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, textureID);
+	}
+
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, layerWidth, layerHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	for (size_t level = 0; level < levels.size() && (GLint)level + 1 < levelCount; level++)
+	{
+		const MipLevel& entry = levels[level];
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level + 1, 0, 0, layer, entry.width, entry.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, levelData + entry.offset);
+	}
+
+	GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::SetSampling(TextureFilter filter, GLfloat anisotropy, GLenum wrapMode)
+{
+	this->filter = filter;
+	this->anisotropy = anisotropy;
+	this->wrapMode = wrapMode;
+
+	if (textureID != 0)
+	{
+		GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, textureID);
+		ApplyTextureSampling(GL_TEXTURE_2D_ARRAY, levelCount, filter, anisotropy, wrapMode);
+		GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+	}
+}
+
+void TextureArray::UseTextureArray()
+{
+	GLState::BindTexture(0, GL_TEXTURE_2D_ARRAY, textureID);
+}
+
+size_t TextureArray::GetResidentBytes()
+{
+	if (textureID == 0)
+	{
+		return 0;
+	}
+
+	size_t bytes = 0;
+	for (int levelWidth = layerWidth, levelHeight = layerHeight; ;)
+	{
+		bytes += (size_t)levelWidth * levelHeight * 4 * layerCapacity;
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+
+		levelWidth = GetNextMipSize(levelWidth);
+		levelHeight = GetNextMipSize(levelHeight);
+	}
+
+	return bytes;
+}
+
+void TextureArray::ClearTextureArray()
+{
+	GLState::ForgetTexture(textureID);
+	glDeleteTextures(1, &textureID);
+	textureID = 0;
+	layerCount = 0;
+	freeLayers.clear();
+	levelCount = 0;
+}
+
+TextureArray::~TextureArray()
+{
+	ClearTextureArray();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "MipChain.h"
+#include "TextureSampling.h"
+
+// RGBA8 images of one size as the layers of a single GL_TEXTURE_2D_ARRAY, so draws that use different
+// images share one binding and only differ in the layer they sample (textureLayer in default.frag)
+//
+// The layer size and count are fixed up front. Texture resamples an image of another size to fit when
+// it decodes, and builds the mips there too; the driver can't generate them for one layer alone.
+class TextureArray
+{
+public:
+	TextureArray();
+	TextureArray(int layerWidth, int layerHeight, int layerCapacity);
+
+	// Next free layer, reusing released ones first, or -1 when the array is full
+	int ReserveLayer();
+
+	// Gives a reserved layer back once no texture samples it; its old pixels stay until it's refilled
+	void ReleaseLayer(int layer);
+
+	// pixels is layerWidth x layerHeight and levels its mips (from BuildMipChain) within levelData. Both
+	// are offsets instead when a GL_PIXEL_UNPACK_BUFFER is bound. Creates the storage on first use.
+	void UploadLayer(int layer, const unsigned char* pixels, const std::vector<MipLevel>& levels, const unsigned char* levelData);
+
+	// Shared by every layer; defaults to trilinear, no anisotropy, GL_REPEAT
+	void SetSampling(TextureFilter filter, GLfloat anisotropy, GLenum wrapMode);
+
+	void UseTextureArray();
+
+	GLuint GetTextureID() { return textureID; }
+	int GetLayerWidth() { return layerWidth; }
+	int GetLayerHeight() { return layerHeight; }
+	int GetLayerCount() { return layerCount - (int)freeLayers.size(); } // reserved and not released
+	int GetLayerCapacity() { return layerCapacity; }
+
+	// GL memory of every layer and its mips, allocated or not
+	size_t GetResidentBytes();
+
+	void ClearTextureArray();
+
+	~TextureArray();
+
+private:
+	GLuint textureID;
+	int layerWidth, layerHeight, layerCapacity;
+	int layerCount; // reserved so far, released ones included
+	std::vector<int> freeLayers; // released, handed out again before layerCount grows
+	GLint levelCount;
+
+	TextureFilter filter;
+	GLfloat anisotropy;
+	GLenum wrapMode;
+
+	void CreateStorage();
+
+	TextureArray(const TextureArray&) = delete;
+	TextureArray& operator=(const TextureArray&) = delete;
+};
@@ -0,0 +1,193 @@
+#include "TextureCache.h"
+#include "Texture.h"
+#include "AssetLoader.h"
+#include "Profiler.h"
+
+#include <filesystem>
+
+TextureCache::TextureCache()
+{
+	hits = 0;
+	misses = 0;
+	preferCompressed = false;
+	cpuMipmaps = false;
+	textureArray = NULL;
+	uploadRing = NULL;
+}
+
+std::shared_ptr<Texture> TextureCache::Acquire(const char* fileLocation, AssetLoader* loader, bool packable)
+{
+	const std::string& canonical = GetCanonicalPath(fileLocation);
+
+	// The key outlives the texture, since the entry is only ever reused, never erased
+	std::unordered_map<std::string, std::weak_ptr<Texture>>::iterator entry = textures.emplace(canonical, std::weak_ptr<Texture>()).first;
+
+	std::shared_ptr<Texture> texture = entry->second.lock();
+	if (texture)
+	{
+		hits++;
+		return texture;
+	}
+
+	PROFILE_ZONE("TextureCache::Acquire miss");
+
+	misses++;
+	texture = std::make_shared<Texture>(entry->first.c_str());
+	texture->SetCpuMipmaps(cpuMipmaps);
+	texture->SetUploadRing(uploadRing);
+
+	if (packable && textureArray != NULL && !IsCompressedImageFile(entry->first.c_str()))
+	{
+		int layer = textureArray->ReserveLayer();
+		if (layer >= 0)
+		{
+			texture->SetArrayLayer(textureArray, layer);
+		}
+	}
+	entry->second = texture;
+
+	if (loader == NULL)
+	{
+		texture->LoadTexture();
+		return texture;
+	}
+
+	// The jobs hold a reference, so the texture survives until it's uploaded even if every user lets go
+	loader->Submit(
+		[texture]()
+		{
+			texture->DecodeTexture();
+		},
+		[texture]()
+		{
+			texture->UploadTexture();
+		});
+
+	return texture;
+}
+
+const std::string& TextureCache::GetCanonicalPath(const char* fileLocation)
+{
+	std::unordered_map<std::string, std::string>::iterator alias = canonicalPaths.find(fileLocation);
+	if (alias == canonicalPaths.end())
+	{
+		// weakly_canonical doesn't need the file to exist; a missing file fails later, in the decode
+		std::error_code error;
+		std::string canonical = std::filesystem::weakly_canonical(fileLocation, error).generic_string();
+		if (error || canonical.empty())
+		{
+			canonical = fileLocation;
+		}
+
+		if (preferCompressed)
+		{
+			std::string compressedLocation = FindCompressedVersion(canonical);
+			if (!compressedLocation.empty())
+			{
+				canonical = compressedLocation;
+			}
+		}
+
+		alias = canonicalPaths.emplace(fileLocation, canonical).first;
+	}
+
+	return alias->second;
+}
+
+bool TextureCache::Reload(const char* fileLocation, AssetLoader* loader)
+{
+	std::unordered_map<std::string, std::weak_ptr<Texture>>::iterator entry = textures.find(GetCanonicalPath(fileLocation));
+	if (entry == textures.end())
+	{
+		return false;
+	}
+
+	std::shared_ptr<Texture> texture = entry->second.lock();
+	if (!texture)
+	{
+		return false;
+	}
+
+	// Same settings, so a packed texture refills its own layer
+	std::shared_ptr<Texture> replacement = std::make_shared<Texture>(entry->first.c_str());
+	replacement->CopySettings(*texture);
+
+	loader->Submit(
+		[replacement]()
+		{
+			replacement->DecodeTexture();
+		},
+		[texture, replacement]()
+		{
+			replacement->UploadTexture();
+			if (replacement->GetResidentBytes() > 0)
+			{
+				texture->SwapTexture(*replacement);
+			}
+		});
+
+	return true;
+}
+
+std::string TextureCache::FindCompressedVersion(const std::string& fileLocation)
+{
+	const char* extensions[2] = { ".ktx2", ".dds" };
+
+	for (int i = 0; i < 2; i++)
+	{
+		std::error_code error;
+		std::filesystem::path candidate = std::filesystem::path(fileLocation).replace_extension(extensions[i]);
+		if (!std::filesystem::exists(candidate, error))
+		{
+			continue;
+		}
+
+		// Only the header is read here; the rest loads with the texture
+		std::string candidateLocation = candidate.generic_string();
+		if (Texture::IsCompressedFormatSupported(PeekCompressedFormat(candidateLocation.c_str())))
+		{
+			return candidateLocation;
+		}
+	}
+
+	return "";
+}
+
+unsigned int TextureCache::GetResidentCount()
+{
+	unsigned int count = 0;
+	for (std::unordered_map<std::string, std::weak_ptr<Texture>>::iterator it = textures.begin(); it != textures.end(); ++it)
+	{
+		if (!it->second.expired())
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+size_t TextureCache::GetResidentBytes()
+{
+	size_t bytes = 0;
+	for (std::unordered_map<std::string, std::weak_ptr<Texture>>::iterator it = textures.begin(); it != textures.end(); ++it)
+	{
+		std::shared_ptr<Texture> texture = it->second.lock();
+		if (texture)
+		{
+			bytes += texture->GetResidentBytes();
+		}
+	}
+
+	return bytes;
+}
+
+void TextureCache::PrintStats()
+{
+	printf("Texture cache: %u hits, %u misses, %u textures resident (%.1f MB)\n",
+		hits, misses, GetResidentCount(), GetResidentBytes() / (1024.0 * 1024.0));
+}
+
+TextureCache::~TextureCache()
+{
+}
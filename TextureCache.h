@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+class Texture;
+class TextureArray;
+class PixelUploadRing;
+class AssetLoader;
+
+// Shares one GL texture between everything that asks for the same image file
+//
+// Entries are keyed on the canonical path, so "Textures/a.jpg" and "./Textures/a.jpg" are one texture.
+// The cache only holds weak references: a texture is freed as soon as the last shared_ptr to it goes,
+// and a later request decodes it again. Use it from the GL thread only.
+class TextureCache
+{
+public:
+	TextureCache();
+
+	// The texture for fileLocation, decoded and uploaded on a miss. With a loader the decode runs on a
+	// worker and the texture stays empty (id 0) until the loader uploads it.
+	// A repeated request doesn't touch the disk at all.
+	// With packable false the image gets a texture of its own even when a texture array is set; the
+	// first request for a file decides.
+	std::shared_ptr<Texture> Acquire(const char* fileLocation, AssetLoader* loader = NULL, bool packable = true);
+
+	// Load "name.ktx2" or "name.dds" (from TextureConverter) in place of "name.jpg" when one exists
+	// and the driver can sample its format. Set before the first Acquire.
+	void SetPreferCompressed(bool prefer) { preferCompressed = prefer; }
+
+	// Build JPEG/PNG mip chains on the decode thread rather than with glGenerateMipmap on the GL
+	// thread (see Texture::SetCpuMipmaps). Set before the first Acquire.
+	void SetCpuMipmaps(bool enabled) { cpuMipmaps = enabled; }
+
+	// Pack every JPEG/PNG into a layer of array while it has room (see Texture::SetArrayLayer);
+	// compressed files keep textures of their own. Set before the first Acquire.
+	void SetTextureArray(TextureArray* array) { textureArray = array; }
+
+	// Decode JPEG/PNG textures into ring and upload them from there (see PixelUploadRing)
+	void SetUploadRing(PixelUploadRing* ring) { uploadRing = ring; }
+
+	// Decodes fileLocation again on the loader's workers and swaps the new image into the existing
+	// texture once uploaded, so everything holding it sees the change. False if it isn't loaded.
+	bool Reload(const char* fileLocation, AssetLoader* loader);
+
+	unsigned int GetHits() { return hits; }
+	unsigned int GetMisses() { return misses; }
+
+	// Textures still referenced somewhere, and the GL memory they take (mip chains included)
+	unsigned int GetResidentCount();
+	size_t GetResidentBytes();
+
+	void PrintStats();
+
+	~TextureCache();
+
+private:
+	// Canonical path -> texture
+	std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+
+	// Path as requested -> canonical path, so a repeated request skips canonicalizing
+	std::unordered_map<std::string, std::string> canonicalPaths;
+
+	unsigned int hits, misses;
+	bool preferCompressed;
+	bool cpuMipmaps;
+	TextureArray* textureArray;
+	PixelUploadRing* uploadRing;
+
+	std::string FindCompressedVersion(const std::string& fileLocation);
+	const std::string& GetCanonicalPath(const char* fileLocation);
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+};
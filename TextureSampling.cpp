@@ -0,0 +1,27 @@
+#include "TextureSampling.h"
+
+void ApplyTextureSampling(GLenum target, GLint levelCount, TextureFilter filter, GLfloat anisotropy, GLenum wrapMode)
+{
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapMode);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapMode);
+
+	// Capped so a partial chain (a compressed file's) stays complete
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	// A compressed file without mips can only be sampled bilinearly
+	bool mipmapped = filter == TEXTURE_FILTER_TRILINEAR && levelCount > 1;
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	if (GLEW_EXT_texture_filter_anisotropic || GLEW_ARB_texture_filter_anisotropic)
+	{
+		static GLfloat maxAnisotropy = 0.0f;
+		if (maxAnisotropy == 0.0f)
+		{
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+		}
+
+		GLfloat clamped = anisotropy < 1.0f ? 1.0f : anisotropy > maxAnisotropy ? maxAnisotropy : anisotropy;
+		glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, clamped);
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// How a texture is minified: TEXTURE_FILTER_TRILINEAR blends between mip levels,
+// TEXTURE_FILTER_BILINEAR samples only the full-size image (and shimmers when shrunk)
+enum TextureFilter
+{
+	TEXTURE_FILTER_BILINEAR,
+	TEXTURE_FILTER_TRILINEAR
+};
+
+// Sets the sampling parameters of the texture bound to target, once its levelCount levels are uploaded.
+// Anisotropy is clamped to what the driver supports (ignored without the extension).
+void ApplyTextureSampling(GLenum target, GLint levelCount, TextureFilter filter, GLfloat anisotropy, GLenum wrapMode);
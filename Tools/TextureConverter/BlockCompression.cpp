@@ -0,0 +1,253 @@
+#include "BlockCompression.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+	// Texels of one 4x4 block, edge texels repeated for blocks that hang over the image
+	void GatherBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, unsigned char block[64])
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			int sourceY = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+			for (int x = 0; x < 4; x++)
+			{
+				int sourceX = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+				memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+			}
+		}
+	}
+
+	uint16_t To565(const float color[3])
+	{
+		int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void From565(uint16_t color, int rgb[3])
+	{
+		int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	void Write16(unsigned char* out, uint16_t value)
+	{
+		out[0] = (unsigned char)(value & 0xFF);
+		out[1] = (unsigned char)(value >> 8);
+	}
+
+	// 8-byte BC1 color block (always the four-color mode, so it's valid inside BC3 too)
+	void EncodeColorBlock(const unsigned char block[64], unsigned char out[8])
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				mean[c] += block[i * 4 + c] / 16.0f;
+			}
+		}
+
+		float covariance[3][3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float d[3] = { block[i * 4] - mean[0], block[i * 4 + 1] - mean[1], block[i * 4 + 2] - mean[2] };
+			for (int row = 0; row < 3; row++)
+			{
+				for (int column = 0; column < 3; column++)
+				{
+					covariance[row][column] += d[row] * d[column];
+				}
+			}
+		}
+
+		// Principal axis by power iteration, starting from the luminance direction
+		float axis[3] = { 0.299f, 0.587f, 0.114f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3];
+			for (int row = 0; row < 3; row++)
+			{
+				next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+			}
+
+			float largest = next[0] * next[0] + next[1] * next[1] + next[2] * next[2];
+			if (largest < 1e-6f)
+			{
+				break; // flat block, any axis will do
+			}
+
+			float scale = 1.0f / sqrtf(largest);
+			for (int c = 0; c < 3; c++)
+			{
+				axis[c] = next[c] * scale;
+			}
+		}
+
+		float minT = 0.0f, maxT = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+			minT = t < minT ? t : minT;
+			maxT = t > maxT ? t : maxT;
+		}
+
+		// Pull the ends in by 1/16 of the range; the extremes are rarely worth the error they put on the rest
+		float inset = (maxT - minT) / 16.0f;
+		minT += inset;
+		maxT -= inset;
+
+		float endpoints[2][3];
+		for (int c = 0; c < 3; c++)
+		{
+			float high = mean[c] + axis[c] * maxT, low = mean[c] + axis[c] * minT;
+			endpoints[0][c] = high < 0.0f ? 0.0f : high > 255.0f ? 255.0f : high;
+			endpoints[1][c] = low < 0.0f ? 0.0f : low > 255.0f ? 255.0f : low;
+		}
+
+		uint16_t color0 = To565(endpoints[0]), color1 = To565(endpoints[1]);
+		if (color0 < color1)
+		{
+			uint16_t swap = color0;
+			color0 = color1;
+			color1 = swap;
+		}
+
+		Write16(out, color0);
+		Write16(out + 2, color1);
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			From565(color0, palette[0]);
+			From565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0, bestError = 0x7FFFFFFF;
+				for (int p = 0; p < 4; p++)
+				{
+					int dr = block[i * 4] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+					int error = dr * dr + dg * dg + db * db;
+					if (error < bestError)
+					{
+						best = p;
+						bestError = error;
+					}
+				}
+				indices |= (uint32_t)best << (i * 2);
+			}
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			out[4 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	// 8-byte BC3 alpha block in the eight-value mode
+	void EncodeAlphaBlock(const unsigned char block[64], unsigned char out[8])
+	{
+		int minAlpha = 255, maxAlpha = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int alpha = block[i * 4 + 3];
+			minAlpha = alpha < minAlpha ? alpha : minAlpha;
+			maxAlpha = alpha > maxAlpha ? alpha : maxAlpha;
+		}
+
+		out[0] = (unsigned char)maxAlpha;
+		out[1] = (unsigned char)minAlpha;
+
+		uint64_t indices = 0;
+		if (maxAlpha != minAlpha)
+		{
+			int palette[8] = { maxAlpha, minAlpha };
+			for (int p = 1; p < 7; p++)
+			{
+				palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int alpha = block[i * 4 + 3];
+				int best = 0, bestError = 256;
+				for (int p = 0; p < 8; p++)
+				{
+					int error = alpha > palette[p] ? alpha - palette[p] : palette[p] - alpha;
+					if (error < bestError)
+					{
+						best = p;
+						bestError = error;
+					}
+				}
+				indices |= (uint64_t)best << (i * 3);
+			}
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			out[2 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	size_t GetBlockCount(int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+	}
+}
+
+size_t GetBC1Size(int width, int height)
+{
+	return GetBlockCount(width, height) * 8;
+}
+
+size_t GetBC3Size(int width, int height)
+{
+	return GetBlockCount(width, height) * 16;
+}
+
+void CompressBC1(const unsigned char* rgba, int width, int height, unsigned char* out)
+{
+	unsigned char block[64];
+
+	for (int blockY = 0; blockY < (height + 3) / 4; blockY++)
+	{
+		for (int blockX = 0; blockX < (width + 3) / 4; blockX++)
+		{
+			GatherBlock(rgba, width, height, blockX, blockY, block);
+			EncodeColorBlock(block, out);
+			out += 8;
+		}
+	}
+}
+
+void CompressBC3(const unsigned char* rgba, int width, int height, unsigned char* out)
+{
+	unsigned char block[64];
+
+	for (int blockY = 0; blockY < (height + 3) / 4; blockY++)
+	{
+		for (int blockX = 0; blockX < (width + 3) / 4; blockX++)
+		{
+			GatherBlock(rgba, width, height, blockX, blockY, block);
+			EncodeAlphaBlock(block, out);
+			EncodeColorBlock(block, out + 8);
+			out += 16;
+		}
+	}
+}
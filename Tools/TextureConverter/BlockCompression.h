@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// CPU encoders for the block formats TextureConverter writes
+//
+// Each 4x4 block gets endpoints from the principal axis of its colors, inset slightly to cut the
+// error at the ends, and every texel takes the nearest palette entry. That's well short of what
+// offline tools with exhaustive searches reach, but fast and good enough for diffuse textures.
+
+// Bytes a width x height image takes once compressed (partial blocks at the edges count as whole)
+size_t GetBC1Size(int width, int height);
+size_t GetBC3Size(int width, int height);
+
+// rgba is width * height * 4 bytes, rows in the order they should end up in the texture
+void CompressBC1(const unsigned char* rgba, int width, int height, unsigned char* out);
+void CompressBC3(const unsigned char* rgba, int width, int height, unsigned char* out);
@@ -0,0 +1,199 @@
+// Offline converter from the JPEG/PNG textures to block-compressed .ktx2 (or .dds) files with mips
+//
+// Usage: TextureConverter [options] <image or directory>...
+//   --format bc1|bc3|auto   auto (the default) uses BC3 only for images with transparency
+//   --container ktx2|dds    defaults to ktx2
+//   --no-mips               store only the full-size level
+//
+// Each output goes next to its input with the extension swapped, which is where the program looks
+// for it when run with --compressed-textures. KTX2 rows are bottom-up like the JPEG path's, so they load
+// without flipping; DDS rows are top-down, as every DDS reader expects.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../stb_image.h"
+#include "../../CompressedImage.h"
+#include "../../MipChain.h"
+#include "BlockCompression.h"
+
+enum FormatChoice
+{
+	CHOOSE_AUTO,
+	CHOOSE_BC1,
+	CHOOSE_BC3
+};
+
+struct ConvertOptions
+{
+	FormatChoice format;
+	CompressedContainer container;
+	bool mipmaps;
+};
+
+bool HasTransparency(const std::vector<unsigned char>& rgba)
+{
+	for (size_t i = 3; i < rgba.size(); i += 4)
+	{
+		if (rgba[i] != 255)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ConvertImage(const std::string& inputLocation, const ConvertOptions& options)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// KTX2 gets the orientation Texture::DecodeTexture uses, so the data can be uploaded as stored
+	bool topDown = options.container == CONTAINER_DDS;
+	stbi_set_flip_vertically_on_load(!topDown);
+
+	int width = 0, height = 0, channels = 0;
+	unsigned char* pixels = stbi_load(inputLocation.c_str(), &width, &height, &channels, 4);
+	if (!pixels)
+	{
+		printf("Failed to read %s: %s\n", inputLocation.c_str(), stbi_failure_reason());
+		return false;
+	}
+
+	std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * 4);
+	stbi_image_free(pixels);
+
+	bool useBC3 = options.format == CHOOSE_BC3 || (options.format == CHOOSE_AUTO && HasTransparency(level));
+
+	CompressedImage image = CompressedImage();
+	image.format = useBC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	image.width = width;
+	image.height = height;
+	image.topDown = topDown;
+
+	size_t uncompressedSize = 0;
+	int levelWidth = width, levelHeight = height;
+	while (true)
+	{
+		CompressedLevel entry;
+		entry.offset = image.data.size();
+		entry.size = useBC3 ? GetBC3Size(levelWidth, levelHeight) : GetBC1Size(levelWidth, levelHeight);
+		entry.width = levelWidth;
+		entry.height = levelHeight;
+
+		image.data.resize(entry.offset + entry.size);
+		if (useBC3)
+		{
+			CompressBC3(level.data(), levelWidth, levelHeight, &image.data[entry.offset]);
+		}
+		else
+		{
+			CompressBC1(level.data(), levelWidth, levelHeight, &image.data[entry.offset]);
+		}
+
+		image.levels.push_back(entry);
+		uncompressedSize += level.size();
+
+		if (!options.mipmaps || (levelWidth == 1 && levelHeight == 1))
+		{
+			break;
+		}
+
+		std::vector<unsigned char> next((size_t)GetNextMipSize(levelWidth) * GetNextMipSize(levelHeight) * 4);
+		DownsampleRGBA8(level.data(), levelWidth, levelHeight, next.data());
+		level.swap(next);
+		levelWidth = GetNextMipSize(levelWidth);
+		levelHeight = GetNextMipSize(levelHeight);
+	}
+
+	std::filesystem::path outputPath = std::filesystem::path(inputLocation).replace_extension(options.container == CONTAINER_DDS ? ".dds" : ".ktx2");
+	std::string outputLocation = outputPath.generic_string();
+	if (!SaveCompressedImage(outputLocation.c_str(), image, options.container))
+	{
+		return false;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%s -> %s: %dx%d %s, %zu levels, %.2f MB (RGBA8: %.2f MB, %.1fx smaller) in %.0f ms\n",
+		inputLocation.c_str(), outputLocation.c_str(), width, height, GetCompressedFormatName(image.format), image.levels.size(),
+		image.data.size() / (1024.0 * 1024.0), uncompressedSize / (1024.0 * 1024.0), (double)uncompressedSize / image.data.size(), elapsed * 1000.0);
+
+	return true;
+}
+
+bool IsSourceImage(const std::filesystem::path& path)
+{
+	std::string extension = path.extension().string();
+	for (size_t i = 0; i < extension.size(); i++)
+	{
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	}
+
+	return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".tga" || extension == ".bmp";
+}
+
+int main(int argc, char* argv[])
+{
+	ConvertOptions options;
+	options.format = CHOOSE_AUTO;
+	options.container = CONTAINER_KTX2;
+	options.mipmaps = true;
+
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			i++;
+			options.format = strcmp(argv[i], "bc1") == 0 ? CHOOSE_BC1 : strcmp(argv[i], "bc3") == 0 ? CHOOSE_BC3 : CHOOSE_AUTO;
+		}
+		else if (strcmp(argv[i], "--container") == 0 && i + 1 < argc)
+		{
+			i++;
+			options.container = strcmp(argv[i], "dds") == 0 ? CONTAINER_DDS : CONTAINER_KTX2;
+		}
+		else if (strcmp(argv[i], "--no-mips") == 0)
+		{
+			options.mipmaps = false;
+		}
+		else
+		{
+			inputs.push_back(argv[i]);
+		}
+	}
+
+	if (inputs.empty())
+	{
+		printf("Usage: TextureConverter [--format bc1|bc3|auto] [--container ktx2|dds] [--no-mips] <image or directory>...\n");
+		return 1;
+	}
+
+	unsigned int failed = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(inputs[i], error))
+		{
+			failed += ConvertImage(inputs[i], options) ? 0 : 1;
+			continue;
+		}
+
+		for (std::filesystem::directory_iterator it(inputs[i], error), end; !error && it != end; it.increment(error))
+		{
+			if (it->is_regular_file(error) && IsSourceImage(it->path()))
+			{
+				failed += ConvertImage(it->path().generic_string(), options) ? 0 : 1;
+			}
+		}
+	}
+
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+#include "VertexLayout.h"
+
+#include <string.h>
+#include <math.h>
+
+namespace
+{
+	int16_t ToSnorm16(float value)
+	{
+		value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+		return (int16_t)lroundf(value * 32767.0f);
+	}
+
+	uint16_t ToUnorm16(float value)
+	{
+		value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+		return (uint16_t)lroundf(value * 65535.0f);
+	}
+
+	uint32_t ToSnorm10(float value)
+	{
+		value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+		return (uint32_t)lroundf(value * 511.0f) & 0x3FF;
+	}
+}
+
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00); // too large (or inf/nan): infinity
+	}
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return (uint16_t)sign; // below the smallest denormal
+		}
+
+		// Denormal: shift the implicit leading one in, rounding to nearest
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+		{
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	// Round to nearest; a carry out of the mantissa correctly bumps the exponent
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+	{
+		half++;
+	}
+	return (uint16_t)half;
+}
+
+GLsizei GetVertexAttributes(const VertexLayout& layout, VertexAttribute attributes[3])
+{
+	GLuint offset = 0;
+
+	VertexAttribute& position = attributes[0];
+	position.location = 0;
+	position.offset = offset;
+	switch (layout.position)
+	{
+	case POSITION_HALF:
+		position.components = 4; // the fourth is padding, the shader only reads xyz
+		position.type = GL_HALF_FLOAT;
+		position.normalized = GL_FALSE;
+		offset += 8;
+		break;
+	case POSITION_SNORM16:
+		position.components = 4;
+		position.type = GL_SHORT;
+		position.normalized = GL_TRUE;
+		offset += 8;
+		break;
+	default:
+		position.components = 3;
+		position.type = GL_FLOAT;
+		position.normalized = GL_FALSE;
+		offset += 12;
+		break;
+	}
+
+	VertexAttribute& texCoord = attributes[1];
+	texCoord.location = 1;
+	texCoord.offset = offset;
+	texCoord.components = 2;
+	if (layout.texCoord == TEXCOORD_UNORM16)
+	{
+		texCoord.type = GL_UNSIGNED_SHORT;
+		texCoord.normalized = GL_TRUE;
+		offset += 4;
+	}
+	else
+	{
+		texCoord.type = GL_FLOAT;
+		texCoord.normalized = GL_FALSE;
+		offset += 8;
+	}
+
+	VertexAttribute& normal = attributes[2];
+	normal.location = 2;
+	normal.offset = offset;
+	if (layout.normal == NORMAL_SNORM10)
+	{
+		normal.components = 4; // packed formats always take 4; w is unused
+		normal.type = GL_INT_2_10_10_10_REV;
+		normal.normalized = GL_TRUE;
+		offset += 4;
+	}
+	else
+	{
+		normal.components = 3;
+		normal.type = GL_FLOAT;
+		normal.normalized = GL_FALSE;
+		offset += 12;
+	}
+
+	return (GLsizei)offset;
+}
+
+void SetVertexAttributes(const VertexLayout& layout)
+{
+	VertexAttribute attributes[3];
+	GLsizei stride = GetVertexAttributes(layout, attributes);
+
+	for (int i = 0; i < 3; i++)
+	{
+		glVertexAttribPointer(attributes[i].location, attributes[i].components, attributes[i].type, attributes[i].normalized,
+			stride, (void*)(uintptr_t)attributes[i].offset);
+		glEnableVertexAttribArray(attributes[i].location);
+	}
+}
+
+void PackVertices(const VertexLayout& layout, const GLfloat* vertices, unsigned int vertexCount,
+	const glm::vec3& center, const glm::vec3& halfExtent, std::vector<unsigned char>& packed)
+{
+	VertexAttribute attributes[3];
+	GLsizei stride = GetVertexAttributes(layout, attributes);
+
+	packed.assign((size_t)stride * vertexCount, 0);
+
+	// A flat axis has nothing to spread across the range
+	glm::vec3 inverseExtent;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		inverseExtent[axis] = halfExtent[axis] > 0.0f ? 1.0f / halfExtent[axis] : 0.0f;
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* source = vertices + (size_t)i * SOURCE_VERTEX_FLOATS;
+		unsigned char* vertex = &packed[(size_t)i * stride];
+
+		unsigned char* position = vertex + attributes[0].offset;
+		if (layout.position == POSITION_SNORM16)
+		{
+			int16_t quantized[4] = { 0, 0, 0, 0 };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				quantized[axis] = ToSnorm16((source[axis] - center[axis]) * inverseExtent[axis]);
+			}
+			memcpy(position, quantized, sizeof(quantized));
+		}
+		else if (layout.position == POSITION_HALF)
+		{
+			uint16_t halves[4] = { FloatToHalf(source[0]), FloatToHalf(source[1]), FloatToHalf(source[2]), 0 };
+			memcpy(position, halves, sizeof(halves));
+		}
+		else
+		{
+			memcpy(position, source, sizeof(GLfloat) * 3);
+		}
+
+		unsigned char* texCoord = vertex + attributes[1].offset;
+		if (layout.texCoord == TEXCOORD_UNORM16)
+		{
+			uint16_t quantized[2] = { ToUnorm16(source[3]), ToUnorm16(source[4]) };
+			memcpy(texCoord, quantized, sizeof(quantized));
+		}
+		else
+		{
+			memcpy(texCoord, source + 3, sizeof(GLfloat) * 2);
+		}
+
+		unsigned char* normal = vertex + attributes[2].offset;
+		if (layout.normal == NORMAL_SNORM10)
+		{
+			uint32_t packedNormal = ToSnorm10(source[5]) | (ToSnorm10(source[6]) << 10) | (ToSnorm10(source[7]) << 20);
+			memcpy(normal, &packedNormal, sizeof(packedNormal));
+		}
+		else
+		{
+			memcpy(normal, source + 5, sizeof(GLfloat) * 3);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// How a mesh stores its vertices: one encoding per attribute, from which the stride, the offsets and
+// the glVertexAttribPointer calls all follow
+//
+// The source is always MeshData's interleaved floats (position 3, tex coord 2, normal 3). Compact encodings:
+//   POSITION_SNORM16  xyz as normalized shorts across the mesh's bounds, plus a pad short; Mesh folds the
+//                     matrix that undoes it into the model matrix (see Mesh::GetDequantization)
+//   POSITION_HALF     xyz as half floats, plus a pad half; no dequantization
+//   TEXCOORD_UNORM16  uv as normalized unsigned shorts, for coordinates within [0, 1]
+//   NORMAL_SNORM10    xyz as normalized 10-bit values in a GL_INT_2_10_10_10_REV
+// Every attribute stays 4-byte aligned. SNORM16 + UNORM16 + SNORM10 is 16 bytes a vertex instead of 32.
+enum PositionEncoding
+{
+	POSITION_FLOAT,
+	POSITION_HALF,
+	POSITION_SNORM16
+};
+
+enum TexCoordEncoding
+{
+	TEXCOORD_FLOAT,
+	TEXCOORD_UNORM16
+};
+
+enum NormalEncoding
+{
+	NORMAL_FLOAT,
+	NORMAL_SNORM10
+};
+
+struct VertexLayout
+{
+	PositionEncoding position;
+	TexCoordEncoding texCoord;
+	NormalEncoding normal;
+};
+
+const VertexLayout FLOAT_VERTEX_LAYOUT = { POSITION_FLOAT, TEXCOORD_FLOAT, NORMAL_FLOAT };
+const VertexLayout COMPACT_VERTEX_LAYOUT = { POSITION_SNORM16, TEXCOORD_UNORM16, NORMAL_SNORM10 };
+
+inline bool operator==(const VertexLayout& a, const VertexLayout& b)
+{
+	return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+}
+
+inline bool operator!=(const VertexLayout& a, const VertexLayout& b)
+{
+	return !(a == b);
+}
+
+// Floats per vertex in MeshData::vertices
+const unsigned int SOURCE_VERTEX_FLOATS = 8;
+
+struct VertexAttribute
+{
+	GLuint location; // 0 position, 1 tex coord, 2 normal, as in default.vert
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	GLuint offset;
+};
+
+// The three attributes in location order; returns the stride they add up to
+GLsizei GetVertexAttributes(const VertexLayout& layout, VertexAttribute attributes[3]);
+
+// Points attributes 0-2 at the buffer bound to GL_ARRAY_BUFFER (with the VAO bound)
+void SetVertexAttributes(const VertexLayout& layout);
+
+// Encodes source vertices; quantized positions are stored relative to center and halfExtent
+void PackVertices(const VertexLayout& layout, const GLfloat* vertices, unsigned int vertexCount,
+	const glm::vec3& center, const glm::vec3& halfExtent, std::vector<unsigned char>& packed);
+
+uint16_t FloatToHalf(float value);
@@ -1,5 +1,18 @@
 #include "Window.h"
 
+#include <chrono>
+#include <vector>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+static double steadySeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 Window::Window()
 {
 	width = 800;
@@ -13,24 +26,42 @@ Window::Window()
 	// Prevent the camera from starting off facing a random direction by setting x and y change values to 0
 	xChange = 0.0f;
 	yChange = 0.0f;
+
+	mainWindow = NULL;
+	sharedWindow = NULL;
+	mouseFirstMoved = true;
+	offscreen = false;
+	frameCount = 0;
+	frameLimit = 0;
+	startTime = 0.0;
+	eglDisplay = NULL;
+	eglConfig = NULL;
+	eglContext = NULL;
+	eglSharedContext = NULL;
+	offscreenFBO = 0;
+	colorRBO = 0;
+	depthRBO = 0;
 }
 
-Window::Window(GLfloat windowWidth, GLfloat windowHeight)
+Window::Window(GLfloat windowWidth, GLfloat windowHeight) : Window(windowWidth, windowHeight, false)
+{
+}
+
+Window::Window(GLfloat windowWidth, GLfloat windowHeight, bool offscreenWindow) : Window()
 {
 	width = windowWidth;
 	height = windowHeight;
+	offscreen = offscreenWindow;
+}
 
-	for (size_t i = 0; i < 1024; i++)
-	{
-		keys[i] = 0;
-	}
+int Window::Initialize()
+{
+	startTime = steadySeconds();
 
-	// Prevent the camera from starting off facing a random direction by setting x and y change values to 0
-	xChange = 0.0f;
-	yChange = 0.0f;
+	return offscreen ? initializeOffscreen() : initializeOnscreen();
 }
 
-int Window::Initialize()
+int Window::initializeOnscreen()
 {
 	if (!glfwInit())
 	{
@@ -75,18 +106,334 @@ int Window::Initialize()
 	{
 		printf("Error: %s", glewGetErrorString(error));
 		glfwDestroyWindow(mainWindow);
+		mainWindow = NULL;
 		glfwTerminate();
 		return -1;
 	}
 
+	// Sets a user-defined pointer for the specified window
+	// Useful for passing the window object to callbacks, or storing associated with a window.
+	glfwSetWindowUserPointer(mainWindow, this);
+
+	return initializeGL();
+}
+
+int Window::initializeOffscreen()
+{
+#ifdef __linux__
+	// Surfaceless platform lets Mesa (llvmpipe included) create a context without any display server
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (getPlatformDisplay)
+	{
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		printf("Error initializing EGL display\n");
+		return -1;
+	}
+	eglDisplay = display;
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		printf("EGL display doesn't support desktop OpenGL\n");
+		destroyOffscreen();
+		return -1;
+	}
+
+	const EGLint configAttribs[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, // the default (window bit) never matches on the surfaceless platform
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+	{
+		printf("No EGL config supports desktop OpenGL\n");
+		destroyOffscreen();
+		return -1;
+	}
+
+	eglConfig = config;
+
+	// Same context version as the GLFW path: OpenGL 3.3 core
+	const EGLint contextAttribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+	{
+		printf("Failed to create an OpenGL 3.3 core EGL context\n");
+		destroyOffscreen();
+		return -1;
+	}
+	eglContext = context;
+
+	// No surface at all - everything is drawn into the FBO created below
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		printf("Failed to make the surfaceless EGL context current\n");
+		destroyOffscreen();
+		return -1;
+	}
+
+	glewExperimental = GL_TRUE;
+
+	// GLEW builds without EGL support report a missing GLX display but still load the GL entry points
+	GLenum error = glewInit();
+	if (error != GLEW_OK && error != GLEW_ERROR_NO_GLX_DISPLAY)
+	{
+		printf("Error: %s", glewGetErrorString(error));
+		destroyOffscreen();
+		return -1;
+	}
+
+	bufferWidth = width;
+	bufferHeight = height;
+
+	// Color + depth renderbuffers stand in for the window's default framebuffer
+	glGenRenderbuffers(1, &colorRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, bufferWidth, bufferHeight);
+
+	glGenRenderbuffers(1, &depthRBO);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, bufferWidth, bufferHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &offscreenFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Offscreen framebuffer is incomplete\n");
+		destroyOffscreen();
+		return -1;
+	}
+
+	printf("Offscreen %dx%d on EGL %d.%d: %s\n", bufferWidth, bufferHeight, major, minor, glGetString(GL_RENDERER));
+
+	return initializeGL();
+#else
+	printf("Offscreen rendering requires EGL and is only available on Linux\n");
+	return -1;
+#endif
+}
+
+int Window::initializeGL()
+{
 	glEnable(GL_DEPTH_TEST); // determines which triangle to draw over others
 
 	// Create viewport
 	glViewport(0, 0, bufferWidth, bufferHeight);
 
-	// Sets a user-defined pointer for the specified window
-	// Useful for passing the window object to callbacks, or storing associated with a window.
-	glfwSetWindowUserPointer(mainWindow, this);
+	return 0;
+}
+
+bool Window::createSharedContext()
+{
+	if (offscreen)
+	{
+#ifdef __linux__
+		const EGLint contextAttribs[] =
+		{
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+
+		EGLContext context = eglCreateContext(eglDisplay, eglConfig, eglContext, contextAttribs);
+		if (context == EGL_NO_CONTEXT)
+		{
+			printf("Failed to create a shared EGL context\n");
+			return false;
+		}
+
+		eglSharedContext = context;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// Same hints as the main window were created with, still in effect
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	sharedWindow = glfwCreateWindow(1, 1, "", NULL, mainWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (!sharedWindow)
+	{
+		printf("Failed to create a shared GLFW context\n");
+		return false;
+	}
+
+	return true;
+}
+
+bool Window::makeSharedContextCurrent(bool current)
+{
+	if (offscreen)
+	{
+#ifdef __linux__
+		EGLContext context = current ? eglSharedContext : EGL_NO_CONTEXT;
+		return eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_TRUE;
+#else
+		return false;
+#endif
+	}
+
+	glfwMakeContextCurrent(current ? sharedWindow : NULL);
+	return sharedWindow != NULL;
+}
+
+void Window::destroySharedContext()
+{
+#ifdef __linux__
+	if (eglSharedContext != NULL)
+	{
+		eglDestroyContext(eglDisplay, eglSharedContext);
+		eglSharedContext = NULL;
+	}
+#endif
+
+	if (sharedWindow != NULL)
+	{
+		glfwDestroyWindow(sharedWindow);
+		sharedWindow = NULL;
+	}
+}
+
+void Window::destroyOffscreen()
+{
+#ifdef __linux__
+	if (eglDisplay == NULL)
+	{
+		return;
+	}
+
+	if (eglContext != NULL)
+	{
+		eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(eglDisplay, eglContext);
+		eglContext = NULL;
+	}
+
+	eglTerminate(eglDisplay);
+	eglDisplay = NULL;
+#endif
+}
+
+bool Window::getShouldClose()
+{
+	if (frameLimit != 0 && frameCount >= frameLimit)
+	{
+		return true;
+	}
+
+	// Offscreen windows have nobody to close them, so they rely on the frame limit
+	if (offscreen)
+	{
+		return false;
+	}
+
+	return glfwWindowShouldClose(mainWindow);
+}
+
+void Window::swapBuffers()
+{
+	frameCount++;
+
+	if (offscreen)
+	{
+		// Nothing to present - just make sure the frame is submitted
+		glFlush();
+		return;
+	}
+
+	glfwSwapBuffers(mainWindow);
+}
+
+void Window::pollEvents()
+{
+	if (!offscreen)
+	{
+		glfwPollEvents();
+	}
+}
+
+void Window::setSwapInterval(int interval)
+{
+	if (!offscreen)
+	{
+		glfwSwapInterval(interval);
+	}
+}
+
+double Window::getTime()
+{
+	if (offscreen)
+	{
+		return steadySeconds() - startTime;
+	}
+
+	return glfwGetTime();
+}
+
+bool Window::saveFramebuffer(const char* fileLocation, bool presented)
+{
+	std::vector<unsigned char> pixels(bufferWidth * bufferHeight * 3);
+
+	// The offscreen FBO isn't touched by swapBuffers, so only the window needs the front buffer
+	bool readFront = presented && !offscreen;
+	if (readFront)
+	{
+		glReadBuffer(GL_FRONT);
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, bufferWidth, bufferHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+	if (readFront)
+	{
+		glReadBuffer(GL_BACK);
+	}
+
+	FILE* file = fopen(fileLocation, "wb");
+	if (!file)
+	{
+		printf("Failed to write %s!\n", fileLocation);
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", bufferWidth, bufferHeight);
+
+	// OpenGL rows start at the bottom, PPM rows start at the top
+	for (GLint row = bufferHeight - 1; row >= 0; row--)
+	{
+		fwrite(&pixels[row * bufferWidth * 3], 1, bufferWidth * 3, file);
+	}
+
+	fclose(file);
+	return true;
 }
 
 
@@ -156,6 +503,24 @@ void Window::handleMouse(GLFWwindow* window, double xPos, double yPos)
 
 Window::~Window()
 {
-	glfwDestroyWindow(mainWindow);
-	glfwTerminate();
-}
\ No newline at end of file
+	destroySharedContext();
+
+	if (offscreen)
+	{
+		// Only the instance that actually created the context tears it down
+		if (eglContext != NULL)
+		{
+			glDeleteFramebuffers(1, &offscreenFBO);
+			glDeleteRenderbuffers(1, &colorRBO);
+			glDeleteRenderbuffers(1, &depthRBO);
+		}
+		destroyOffscreen();
+		return;
+	}
+
+	if (mainWindow != NULL)
+	{
+		glfwDestroyWindow(mainWindow);
+		glfwTerminate();
+	}
+}
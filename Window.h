@@ -1,4 +1,3 @@
-
 #include <stdio.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -10,12 +9,15 @@ public:
 
 	Window(GLfloat windowWidth, GLfloat windowHeight);
 
+	// Offscreen windows render into an FBO on a surfaceless EGL context instead of opening a GLFW window
+	Window(GLfloat windowWidth, GLfloat windowHeight, bool offscreen);
+
 	int Initialize();
 
 	GLfloat getBufferWidth() { return bufferWidth; }
 	GLfloat getBufferHeight() { return bufferHeight; }
 
-	bool getShouldClose() { return glfwWindowShouldClose(mainWindow); }
+	bool getShouldClose();
 
 	bool* getsKeys() { return keys;  }
 
@@ -23,12 +25,38 @@ public:
 	GLfloat getXChange();
 	GLfloat getYChange();
 
-	void swapBuffers() { glfwSwapBuffers(mainWindow); }
+	void swapBuffers();
+	void pollEvents();
+
+	// Seconds since initialization (GLFW timer on screen, steady clock offscreen)
+	double getTime();
+
+	// Close the window after the given number of swapped frames (0 = run until closed)
+	void setFrameLimit(unsigned int frames) { frameLimit = frames; }
+	unsigned int getFrameCount() { return frameCount; }
+	// True while drawing the frame the limit stops at, so it can be read back before it's swapped
+	bool isLastFrame() { return frameLimit != 0 && frameCount + 1 >= frameLimit; }
+
+	bool isOffscreen() { return offscreen; }
+
+	// 0 disables vsync so frame times aren't capped by the display
+	void setSwapInterval(int interval);
+
+	// Writes the frame being drawn to a binary PPM file. The back buffer is undefined after a swap, so
+	// once a frame is on screen pass presented to read it from the front buffer instead
+	bool saveFramebuffer(const char* fileLocation, bool presented = false);
+
+	// Second context sharing programs, buffers and textures with this one, for GL work on another thread
+	// Created on the main thread; the other thread binds it with makeSharedContextCurrent
+	bool createSharedContext();
+	bool makeSharedContextCurrent(bool current);
+	void destroySharedContext();
 
 	~Window();
 
 private:
 	GLFWwindow* mainWindow;
+	GLFWwindow* sharedWindow; // hidden, only there for its context
 
 	GLint width, height;
 
@@ -42,6 +70,22 @@ private:
 	GLfloat yChange;
 	bool mouseFirstMoved;
 
+	bool offscreen;
+	unsigned int frameCount, frameLimit;
+	double startTime;
+
+	// EGL handles are kept as void* so this header doesn't depend on EGL on platforms without it
+	void* eglDisplay;
+	void* eglConfig;
+	void* eglContext;
+	void* eglSharedContext;
+	GLuint offscreenFBO, colorRBO, depthRBO;
+
+	int initializeOnscreen();
+	int initializeOffscreen();
+	int initializeGL();
+	void destroyOffscreen();
+
 	void createCallbacks();
 
 	// Only key and action will be used
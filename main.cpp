@@ -6,9 +6,14 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <cmath>
 #include <vector>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <filesystem>
 
 #include <gl/glew.h>
 #include <GLFW/glfw3.h>
@@ -22,11 +27,28 @@
 
 #include "Window.h"
 #include "Mesh.h"
+#include "GeometryArena.h"
+#include "StaticBatch.h"
+#include "GLState.h"
 #include "Shader.h"
 #include "Camera.h"
 #include "Texture.h"
 #include "Light.h"
 #include "Material.h"
+#include "Benchmark.h"
+#include "GpuTimer.h"
+#include "Profiler.h"
+#include "AssetLoader.h"
+#include "RenderQueue.h"
+#include "FrameUniforms.h"
+#include "NormalMatrix.h"
+#include "Frustum.h"
+#include "ShaderCache.h"
+#include "ShaderVariants.h"
+#include "FileWatcher.h"
+#include "TextureCache.h"
+#include "TextureArray.h"
+#include "PixelUploadRing.h"
 
 
 // Window dimensions
@@ -34,17 +56,34 @@ const float toRadians = M_PI / 180.0f; // Converts a number times the variable t
 
 Window mainWindow;
 std::vector<Mesh*> meshList;
-std::vector<Shader> shaderList;
+
+// Every scene mesh is carved out of these shared buffers unless --no-geometry-arena
+GeometryArena staticGeometry;
+std::vector<Shader*> shaderList;
 Camera camera;
 
 bool isPerspective = true;
 
-Texture planeTexture;
-Texture keyboardTexture;
-Texture mousepadTexture;
-Texture keycapTexture;
-Texture micstandTexture;
-Texture micTexture;
+// With --texture-array the JPEGs are resized to one layer size and share a single binding.
+// Defined before the textures so it outlives them; they give their layers back when destroyed
+TextureArray materialTextures(1920, 1080, 5); // one layer per packed image in LoadTextures
+
+// Objects ask the cache for their image by path; ones that share a file share the texture
+TextureCache textureCache;
+std::shared_ptr<Texture> planeTexture;
+std::shared_ptr<Texture> keyboardTexture;
+std::shared_ptr<Texture> mousepadTexture;
+std::shared_ptr<Texture> keycapTexture;
+std::shared_ptr<Texture> micstandTexture;
+std::shared_ptr<Texture> micTexture;
+std::shared_ptr<Texture> baseTexture;
+
+// With --upload-ring decoded textures go through persistently mapped PBO memory
+PixelUploadRing uploadRing;
+
+// Reloaded one after another by --texture-stream-bench
+const char* streamedTextures[] = { "Textures/woodTex.jpg", "Textures/blackTex.jpg", "Textures/designTex.jpg",
+	"Textures/grayTex.jpg", "Textures/blueTex.jpg", "Textures/meshTex.jpg" };
 
 Light mainLight;
 
@@ -54,16 +93,51 @@ Material dullMaterial;
 GLfloat deltaTime = 0.0f; // change in time
 GLfloat lastTime = 0.0f;
 
+// CPU timing stages reported by --bench, in the order they run each frame
+// The draw stages only queue their objects (the GL work is in the flush stage), and double as the
+// GPU timer groups reported by --gpu-timers
+enum FrameStage
+{
+	STAGE_INPUT,
+	STAGE_UNIFORMS,
+	STAGE_PLANE,
+	STAGE_MOUSEPAD,
+	STAGE_KEYBOARD,
+	STAGE_KEYCAPS,
+	STAGE_MICSTAND,
+	STAGE_MIC,
+	STAGE_BASE,
+	STAGE_FLUSH,
+	STAGE_SWAP,
+	STAGE_COUNT
+};
+
+static const char* stageNames[STAGE_COUNT] =
+{
+	"input", "uniform setup", "draw plane", "draw mousepad", "draw keyboard",
+	"draw keycaps", "draw mic stand", "draw mic", "draw base", "flush queue", "swap"
+};
+
+Benchmark benchmark;
+GpuTimer gpuTimer;
+RenderQueue renderQueue;
+FrameUniforms frameUniforms;
+Frustum viewFrustum;
+
 // Vertex Shader Program
 static const char* vShader = "Shaders/default.vert";
 /* Fragment Shader Source Code*/
 static const char* fShader = "Shaders/default.frag";
+// The default vertex shader with its old per-vertex inverse(), kept as the --vertex-bench baseline
+static const char* vBenchInverseShader = "Shaders/bench_inverse.vert";
 
 /* This function computes the average normals for a mesh by calculating face normals for triangles
 *  and then normalizing them to get smoother normals for each vertex
 */
 void calcAverageNorms(unsigned int* indices, unsigned int indiceCount, GLfloat* vertices, unsigned int verticeCount, unsigned int vertLength, unsigned int normalOffset)
 {
+	PROFILE_ZONE("calcAverageNorms");
+
 	for (size_t i = 0; i < indiceCount; i+=3) // increments 3 at a time - Checks each line of 3 indices at a time
 	{
 		unsigned int in0 = indices[i]     * vertLength;
@@ -103,9 +177,11 @@ void calcAverageNorms(unsigned int* indices, unsigned int indiceCount, GLfloat*
 	}
 }
 
-void CreateObjects()
+MeshData CreatePlaneData()
 {
-	GLfloat planeVertices[] =
+	MeshData plane;
+
+	plane.vertices =
 	{
 		//    Positions      Tex Coords    Normals
 		-1.0f, -0.5f,  1.0f,  0.0f, 0.0f,  0.0f, 0.0f, 0.0f,
@@ -115,21 +191,23 @@ void CreateObjects()
 		-1.0f, -0.5f, -1.0f,  1.0f, 0.0f,  0.0f, 0.0f, 0.0f
 	};
 
-	unsigned int planeIndices[] =
+	plane.indices =
 	{
 		0, 1, 2, // first triangle
 		0, 2, 3  // second triangle
 	};
 
 	// Calculate the Normals using the `calcAverageNorms()` function
-	calcAverageNorms(planeIndices, 6, planeVertices, 32, 8, 5);
+	calcAverageNorms(plane.indices.data(), 6, plane.vertices.data(), 32, 8, 5);
+
+	return plane;
+}
 
-	Mesh *planeMesh = new Mesh();
-	planeMesh->CreateMesh(planeVertices, planeIndices, 32, 6);
-	meshList.push_back(planeMesh);
-	
+MeshData CreateCubeData()
+{
+	MeshData cube;
 
-	GLfloat cubeVerts[] =
+	cube.vertices =
 	{
 		//   Positions        Tex Coords   Normals
 		-0.5f, -0.5f,  0.5f,  0.0f, 1.0f,  0.0f, 0.0f, 0.0f,
@@ -143,7 +221,7 @@ void CreateObjects()
 		-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,  0.0f, 0.0f, 0.0f
 	};
 
-	unsigned int cubeIndices[] =
+	cube.indices =
 	{
 		// Front Face
 		0, 1, 2,
@@ -171,14 +249,16 @@ void CreateObjects()
 	};
 
 	// Calculate the Normals for cubes
-	calcAverageNorms(cubeIndices, 36, cubeVerts, 64, 8, 5);
+	calcAverageNorms(cube.indices.data(), 36, cube.vertices.data(), 64, 8, 5);
+
+	return cube;
+}
 
-	// Mouse pad shape
-	Mesh *mousepadMesh = new Mesh();
-	mousepadMesh->CreateMesh(cubeVerts, cubeIndices, 64, 36);
-	meshList.push_back(mousepadMesh);
+MeshData CreateRectangleData()
+{
+	MeshData rectangle;
 
-	GLfloat rectangleVerts[] = {
+	rectangle.vertices = {
 		// Positions          Tex Coords      Normals
 		// Front Face
 		-1.0f, -1.0f,  1.0f,  0.0f, 0.0f,     0.0f, 0.0f, 1.0f,
@@ -193,7 +273,7 @@ void CreateObjects()
 		-1.0f,  1.0f, -1.0f,  0.0f, 1.0f,     0.0f, 0.0f, -1.0f,
 	};
 
-	unsigned int rectangleIndices[] = {
+	rectangle.indices = {
 		// Front Face
 		0, 1, 2,
 		2, 3, 0,
@@ -219,22 +299,16 @@ void CreateObjects()
 		1, 0, 4
 	};
 
-	calcAverageNorms(rectangleIndices, 36, rectangleVerts, 64, 8, 5);
+	calcAverageNorms(rectangle.indices.data(), 36, rectangle.vertices.data(), 64, 8, 5);
 
-	// Keyboard shape
-	Mesh* keyboardMesh = new Mesh();
-	keyboardMesh->CreateMesh(rectangleVerts, rectangleIndices, 64, 36);
-	meshList.push_back(keyboardMesh);
+	return rectangle;
+}
 
-	// Keyboard keys
-	Mesh* keysMesh = new Mesh();
-	keysMesh->CreateMesh(cubeVerts, cubeIndices, 64, 36);
-	meshList.push_back(keysMesh);
+MeshData CreateCylinderData()
+{
+	MeshData cylinder;
 
-	// TODO: Add verts/inds/meshes for a cylinder and sphere
-	
-	// Cylinder
-	GLfloat cylinderVerts[] =
+	cylinder.vertices =
 	{
 		// Positions                Tex Coords   Normals
 		// Base
@@ -257,7 +331,7 @@ void CreateObjects()
 		0.0f, 2.0f, 0.0f,           0.0f, 0.0f,  0.0f, 0.0f, 0.0f
 	};
 
-	GLuint cylinderIndices[] = {
+	cylinder.indices = {
 		// Base
 		0, 1, 2,
 		0, 2, 3,
@@ -273,20 +347,14 @@ void CreateObjects()
 		10, 12, 13,
 	};
 
-	//calcAverageNorms(cylinderIndices, 24, cylinderVerts, 96, 8, 5);
+	//calcAverageNorms(cylinder.indices.data(), 24, cylinder.vertices.data(), 96, 8, 5);
 
-	// Mic stand shape
-	Mesh* micstandMesh = new Mesh();
-	micstandMesh->CreateMesh(cylinderVerts, cylinderIndices, 96, 24);
-	meshList.push_back(micstandMesh);
-
-	// Cone shape removed
+	return cylinder;
+}
 
-	// Sphere
-	const int numLatitudeSegments = 16;
-	const int numLongitudeSegments = 32;
-	std::vector<GLfloat> sphereVerts;
-	std::vector<GLuint> sphereIndices;
+MeshData CreateUVSphereData(int numLatitudeSegments, int numLongitudeSegments)
+{
+	MeshData sphere;
 
 	float radius = 0.5f;
 	for (int lat = 0; lat <= numLatitudeSegments; ++lat) {
@@ -299,14 +367,14 @@ void CreateObjects()
 			float u = static_cast<float>(lon) / numLongitudeSegments;
 			float v = static_cast<float>(lat) / numLatitudeSegments;
 
-			sphereVerts.push_back(x);
-			sphereVerts.push_back(y);
-			sphereVerts.push_back(z);
-			sphereVerts.push_back(u);
-			sphereVerts.push_back(v);
-			sphereVerts.push_back(x);
-			sphereVerts.push_back(y);
-			sphereVerts.push_back(z);
+			sphere.vertices.push_back(x);
+			sphere.vertices.push_back(y);
+			sphere.vertices.push_back(z);
+			sphere.vertices.push_back(u);
+			sphere.vertices.push_back(v);
+			sphere.vertices.push_back(x);
+			sphere.vertices.push_back(y);
+			sphere.vertices.push_back(z);
 		}
 	}
 
@@ -314,26 +382,32 @@ void CreateObjects()
 		for (int lon = 0; lon < numLongitudeSegments; ++lon) {
 			int currRow = lat * (numLongitudeSegments + 1);
 			int nextRow = (lat + 1) * (numLongitudeSegments + 1);
-			sphereIndices.push_back(currRow + lon);
-			sphereIndices.push_back(nextRow + lon);
-			sphereIndices.push_back(currRow + lon + 1);
-			sphereIndices.push_back(nextRow + lon);
-			sphereIndices.push_back(nextRow + lon + 1);
-			sphereIndices.push_back(currRow + lon + 1);
+			sphere.indices.push_back(currRow + lon);
+			sphere.indices.push_back(nextRow + lon);
+			sphere.indices.push_back(currRow + lon + 1);
+			sphere.indices.push_back(nextRow + lon);
+			sphere.indices.push_back(nextRow + lon + 1);
+			sphere.indices.push_back(currRow + lon + 1);
 		}
 	}
 
-	//calcAverageNorms(sphereIndices.data(), static_cast<int>(sphereIndices.size()), sphereVerts.data(), static_cast<int>(sphereVerts.size()), 8, 5);
+	//calcAverageNorms(sphere.indices.data(), static_cast<int>(sphere.indices.size()), sphere.vertices.data(), static_cast<int>(sphere.vertices.size()), 8, 5);
+
+	return sphere;
+}
+
+MeshData CreateSphereData()
+{
+	return CreateUVSphereData(16, 32);
+}
 
-	Mesh* sphereMesh = new Mesh();
-	sphereMesh->CreateMesh(sphereVerts.data(), sphereIndices.data(), static_cast<int>(sphereVerts.size()), static_cast<int>(sphereIndices.size()));
-	meshList.push_back(sphereMesh);
+MeshData CreateCircleData()
+{
+	MeshData fullCircle;
 
 	// Full circle shape
 	const int numSegments = 64; // Increase the number of segments for smoother circle
-	radius = 0.5f;
-	std::vector<GLfloat> fullCircleVerts;
-	std::vector<GLuint> fullCircleIndices;
+	float radius = 0.5f;
 
 	for (int i = 0; i <= numSegments; ++i)
 	{
@@ -343,69 +417,765 @@ void CreateObjects()
 		float u = static_cast<float>(i) / numSegments;
 		float v = 0.5f; // Keep v-coordinate constant for full circle
 
-		fullCircleVerts.push_back(x);
-		fullCircleVerts.push_back(y);
-		fullCircleVerts.push_back(0.0f);
-		fullCircleVerts.push_back(u);
-		fullCircleVerts.push_back(v);
-		fullCircleVerts.push_back(0.0f);
-		fullCircleVerts.push_back(0.0f);
-		fullCircleVerts.push_back(1.0f);
+		fullCircle.vertices.push_back(x);
+		fullCircle.vertices.push_back(y);
+		fullCircle.vertices.push_back(0.0f);
+		fullCircle.vertices.push_back(u);
+		fullCircle.vertices.push_back(v);
+		fullCircle.vertices.push_back(0.0f);
+		fullCircle.vertices.push_back(0.0f);
+		fullCircle.vertices.push_back(1.0f);
 
 		if (i > 0)
 		{
-			fullCircleIndices.push_back(0);
-			fullCircleIndices.push_back(i);
-			fullCircleIndices.push_back(i + 1);
+			fullCircle.indices.push_back(0);
+			fullCircle.indices.push_back(i);
+			fullCircle.indices.push_back(i + 1);
 		}
 	}
 
-	// Create the mesh for the full circle
-	Mesh* fullCircleMesh = new Mesh();
-	fullCircleMesh->CreateMesh(fullCircleVerts.data(), fullCircleIndices.data(),
-		static_cast<int>(fullCircleVerts.size()),
-		static_cast<int>(fullCircleIndices.size()));
-	meshList.push_back(fullCircleMesh);
+	return fullCircle;
+}
+
+// Queues one vertex generation job per shape on the loader's workers; the GL thread uploads each
+// result into its fixed slot in meshList once it's ready
+void CreateMeshAsync(AssetLoader& loader, std::vector<unsigned int> slots, MeshData (*generate)(), const VertexLayout& layout)
+{
+	std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+
+	loader.Submit(
+		[data, generate]()
+		{
+			*data = generate();
+		},
+		[data, slots, layout]()
+		{
+			for (size_t i = 0; i < slots.size(); i++)
+			{
+				meshList[slots[i]]->CreateMesh(*data, layout);
+			}
+		});
+}
+
+void CreateObjects(AssetLoader& loader, const VertexLayout& layout, GeometryArena* arena)
+{
+	PROFILE_ZONE("CreateObjects");
+
+	// Slot order is what the render loop indexes into
+	const unsigned int meshCount = 7;
+	for (unsigned int i = 0; i < meshCount; i++)
+	{
+		meshList.push_back(new Mesh());
+		meshList.back()->SetGeometryArena(arena);
+	}
+
+	CreateMeshAsync(loader, { 0 }, CreatePlaneData, layout);       // plane
+	CreateMeshAsync(loader, { 1, 3 }, CreateCubeData, layout);     // mouse pad, keyboard keys
+	CreateMeshAsync(loader, { 2 }, CreateRectangleData, layout);   // keyboard
+	CreateMeshAsync(loader, { 4 }, CreateCylinderData, layout);    // mic stand
+	CreateMeshAsync(loader, { 5 }, CreateSphereData, layout);      // mic (cone shape removed)
+	CreateMeshAsync(loader, { 6 }, CreateCircleData, layout);      // mic stand base
 }
 
-void CreateShaders()
+void LoadTextures(AssetLoader& loader)
 {
-	Shader *shader1 = new Shader();
-	shader1->CreateFromFiles(vShader, fShader);
-	shaderList.push_back(*shader1);
+	// Textures for all objects
+	// Decoded on the loader's workers, uploaded on the GL thread once the pixels are ready
+	// The floor keeps its own texture: it's twice the array's resolution and needs anisotropic sampling
+	planeTexture = textureCache.Acquire("Textures/woodTex.jpg", &loader, false);
+	keyboardTexture = textureCache.Acquire("Textures/blackTex.jpg", &loader);
+	mousepadTexture = textureCache.Acquire("Textures/designTex.jpg", &loader);
+	keycapTexture = textureCache.Acquire("Textures/grayTex.jpg", &loader);
+	micstandTexture = textureCache.Acquire("Textures/blueTex.jpg", &loader);
+	micTexture = textureCache.Acquire("Textures/meshTex.jpg", &loader);
+	baseTexture = textureCache.Acquire("Textures/blueTex.jpg", &loader); // same image as the stand
+
+	// The floor tiles the wood ten times and is mostly seen at a grazing angle
+	planeTexture->SetSampling(TEXTURE_FILTER_TRILINEAR, 8.0f, GL_REPEAT);
 }
 
-int main()
+void CreateShaders(ShaderVariants& variants, bool textureArray)
 {
-	mainWindow = Window(800, 600);
-	mainWindow.Initialize();
+	PROFILE_ZONE("CreateShaders");
+
+	// Textured with specular highlights, one light
+	shaderList.push_back(variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR));
+
+	// Same, with the model matrix coming from a per-instance attribute
+	shaderList.push_back(variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR | FEATURE_INSTANCED));
+
+	// Same, reading the model matrix of a static batch object from its transform buffer
+	shaderList.push_back(variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR | FEATURE_BATCHED));
+
+	// All three again, sampling a layer of the texture array
+	if (textureArray)
+	{
+		shaderList.push_back(variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR | FEATURE_TEXTURE_ARRAY));
+		shaderList.push_back(variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR | FEATURE_INSTANCED | FEATURE_TEXTURE_ARRAY));
+		shaderList.push_back(variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR | FEATURE_BATCHED | FEATURE_TEXTURE_ARRAY));
+	}
+}
+
+// The textured shader for a draw: packed textures need the TEXTURE_ARRAY variants
+Shader* GetTexturedShader(Texture* texture, bool instanced)
+{
+	return shaderList[(instanced ? 1 : 0) + (texture->GetArrayLayer() >= 0 ? 3 : 0)];
+}
+
+// The textured shader for a StaticBatch
+Shader* GetBatchedShader(Texture* texture)
+{
+	return shaderList[2 + (texture->GetArrayLayer() >= 0 ? 3 : 0)];
+}
+
+// Compares vertex throughput of the old per-vertex inverse() against the precomputed normal matrix
+// Rasterization is discarded so only vertex shading is timed
+void RunVertexBenchmark(unsigned int draws)
+{
+	MeshData sphereData = CreateUVSphereData(256, 512);
+	Mesh sphere;
+	sphere.CreateMesh(sphereData);
+
+	Shader inverseShader, normalMatrixShader;
+	inverseShader.CreateFromFiles(vBenchInverseShader, fShader);
+	normalMatrixShader.CreateFromFiles(vShader, fShader);
+
+	FrameUniforms benchUniforms;
+	benchUniforms.CreateBuffer();
+
+	PerFrameData perFrame = {};
+	perFrame.projection = glm::perspective(glm::radians(45.0f), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 100.0f);
+	perFrame.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	perFrame.eyePosition = glm::vec3(0.0f, 0.0f, 3.0f);
+	perFrame.padding = 0.0f;
+	mainLight.UseLight(perFrame.directionalLights[0]);
+	benchUniforms.Update(perFrame);
+
+	// Non-uniform scale, so the normal matrix really needs the inverse transpose
+	glm::mat4 model = glm::mat4(1.0f);
+	model = glm::rotate(model, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	model = glm::scale(model, glm::vec3(1.0f, 2.0f, 0.5f));
+	glm::mat3 normalMatrix = CalculateNormalMatrix(model);
+
+	Shader* shaders[2] = { &inverseShader, &normalMatrixShader };
+	const char* names[2] = { "inverse() per vertex", "precomputed normal matrix" };
+	double vertsPerSecond[2] = { 0.0, 0.0 };
+	double vertsPerDraw = (double)sphereData.indices.size();
+
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	for (int i = 0; i < 2; i++)
+	{
+		shaders[i]->UseShader();
+		shaders[i]->Set(UniformName("model"), model);
+		shaders[i]->Set(UniformName("normalMatrix"), normalMatrix);
+		sphere.BindMesh();
+
+		// One untimed draw so shader compilation on first use isn't measured
+		sphere.DrawMesh();
+		glFinish();
+
+		double start = mainWindow.getTime();
+		for (unsigned int draw = 0; draw < draws; draw++)
+		{
+			sphere.DrawMesh();
+		}
+		glFinish();
+		double elapsed = mainWindow.getTime() - start;
+
+		vertsPerSecond[i] = elapsed > 0.0 ? vertsPerDraw * draws / elapsed : 0.0;
+	}
+
+	glDisable(GL_RASTERIZER_DISCARD);
+	GLState::BindVertexArray(0);
+	GLState::UseProgram(0);
+
+	printf("Vertex throughput over %u draws of %.0f vertices (rasterizer discarded):\n", draws, vertsPerDraw);
+	printf("  %-28s %8.1f Mverts/s\n", names[0], vertsPerSecond[0] / 1e6);
+	printf("  %-28s %8.1f Mverts/s (%.2fx)\n", names[1], vertsPerSecond[1] / 1e6,
+		vertsPerSecond[0] > 0.0 ? vertsPerSecond[1] / vertsPerSecond[0] : 0.0);
+}
+
+// Draws a grid of objectCount small props (four meshes sharing a geometry arena, one texture) through
+// the render queue one object at a time, then as a static batch on each draw path the driver has,
+// and reports the CPU time a frame spends queueing draws and flushing them to GL. A software driver
+// shades vertices inside the draw calls, so there the flush time is mostly the driver's work.
+void RunBatchBenchmark(ShaderVariants& variants, unsigned int objectCount)
+{
+	GeometryArena benchGeometry;
+	benchGeometry.CreateArena(FLOAT_VERTEX_LAYOUT, 65536, 196608);
+
+	MeshData (*generators[4])() = { CreateCubeData, CreateSphereData, CreateCylinderData, CreateCircleData };
+	Mesh props[4];
+	for (int i = 0; i < 4; i++)
+	{
+		props[i].SetGeometryArena(&benchGeometry);
+		props[i].CreateMesh(generators[i]());
+	}
+
+	Texture benchTexture("Textures/grayTex.jpg");
+	benchTexture.LoadTexture();
+	Material benchMaterial(0.3f, 4);
+
+	Shader* perObjectShader = variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR);
+	Shader* batchShader = variants.Get(FEATURE_TEXTURE | FEATURE_SPECULAR | FEATURE_BATCHED);
+
+	// Square grid seen from above at an angle, every object in view
+	unsigned int side = (unsigned int)ceil(sqrt((double)objectCount));
+	std::vector<glm::mat4> transforms(objectCount);
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3((GLfloat)(i % side) - side * 0.5f, 0.0f, (GLfloat)(i / side) - side * 0.5f));
+		model = glm::rotate(model, glm::radians((GLfloat)(i * 37 % 360)), glm::vec3(0.0f, 1.0f, 0.0f));
+		model = glm::scale(model, glm::vec3(0.3f, 0.3f + 0.1f * (i % 3), 0.3f));
+		transforms[i] = model;
+	}
+
+	FrameUniforms benchUniforms;
+	benchUniforms.CreateBuffer();
+
+	PerFrameData perFrame = {};
+	glm::vec3 eye = glm::vec3(0.0f, side * 0.6f, side * 0.7f);
+	perFrame.projection = glm::perspective(glm::radians(45.0f), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, side * 4.0f);
+	perFrame.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	perFrame.eyePosition = eye;
+	perFrame.padding = 0.0f;
+	mainLight.UseLight(perFrame.directionalLights[0]);
+	benchUniforms.Update(perFrame);
+
+	int width = (int)mainWindow.getBufferWidth(), height = (int)mainWindow.getBufferHeight();
+	std::vector<unsigned char> reference((size_t)width * height * 4), pixels(reference.size());
+
+	const unsigned int frames = 20;
+	RenderQueue benchQueue;
+
+	printf("Drawing %u objects, CPU time per frame averaged over %u frames:\n", objectCount, frames);
+
+	// First the render queue, one Submit per object; then one batch per path, best first
+	int firstPath = (int)StaticBatch::GetBestPath();
+	for (int run = firstPath - 1; run <= (int)BATCH_PATH_PER_DRAW; run++)
+	{
+		StaticBatch batch;
+		if (run >= firstPath)
+		{
+			for (unsigned int i = 0; i < objectCount; i++)
+			{
+				batch.AddObject(&props[i % 4], transforms[i]);
+			}
+			batch.BuildBatch((BatchPath)run);
+		}
+
+		double submitTime = 0.0, flushTime = 0.0;
+		for (unsigned int frame = 0; frame < frames + 2; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			double start = mainWindow.getTime();
+			benchQueue.Begin();
+			if (run < firstPath)
+			{
+				for (unsigned int i = 0; i < objectCount; i++)
+				{
+					benchQueue.Submit(perObjectShader, &props[i % 4], &benchTexture, &benchMaterial, transforms[i], 0);
+				}
+			}
+			else
+			{
+				benchQueue.SubmitBatch(batchShader, &batch, &benchTexture, &benchMaterial, 0);
+			}
+			double submitted = mainWindow.getTime();
+			benchQueue.Flush();
+			double flushed = mainWindow.getTime();
+
+			// The GPU's share isn't counted, and the first two frames warm up the driver
+			glFinish();
+			if (frame >= 2)
+			{
+				submitTime += submitted - start;
+				flushTime += flushed - submitted;
+			}
+		}
+
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, run < firstPath ? reference.data() : pixels.data());
+
+		if (run < firstPath)
+		{
+			printf("  %-20s submit %8.3f ms, flush %8.3f ms\n", "render queue", submitTime * 1000.0 / frames, flushTime * 1000.0 / frames);
+		}
+		else
+		{
+			int maxDifference = 0;
+			for (size_t i = 0; i < pixels.size(); i++)
+			{
+				int difference = abs((int)pixels[i] - (int)reference[i]);
+				maxDifference = difference > maxDifference ? difference : maxDifference;
+			}
+			printf("  %-20s submit %8.3f ms, flush %8.3f ms (image differs by at most %d/255)\n", StaticBatch::GetPathName((BatchPath)run),
+				submitTime * 1000.0 / frames, flushTime * 1000.0 / frames, maxDifference);
+		}
+	}
+
+	GLState::BindVertexArray(0);
+	GLState::UseProgram(0);
+}
+
+// Shader::ReadFile before ShaderSource, kept as the baseline for RunShaderLoadBenchmark
+std::string ReadFileByLine(const char* fileLocation)
+{
+	std::string content;
+	std::ifstream fileStream(fileLocation, std::ios::in);
+
+	if (!fileStream.is_open())
+	{
+		return "";
+	}
+
+	std::string line = "";
+	while (!fileStream.eof())
+	{
+		std::getline(fileStream, line);
+		content.append(line + "\n");
+	}
+
+	fileStream.close();
+	return content;
+}
+
+// Times loading a generated shader of about sizeKB that includes a file of the same size:
+// line by line, with one read per file, and from the file cache
+void RunShaderLoadBenchmark(unsigned int sizeKB)
+{
+	std::error_code error;
+	std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "shader_load_bench";
+	std::filesystem::create_directories(directory, error);
+
+	std::string includeLocation = (directory / "lighting.glsl").string();
+	std::string shaderLocation = (directory / "bench.frag").string();
+
+	std::string includeCode, shaderCode = "#version 330\n#include \"lighting.glsl\"\n";
+	char line[128];
+	for (unsigned int i = 0; includeCode.size() < sizeKB * 1024; i++)
+	{
+		snprintf(line, sizeof(line), "float light%u(float x) { return x * %u.5 + 0.25; }\n", i, i % 97);
+		includeCode += line;
+	}
+	for (unsigned int i = 0; shaderCode.size() < sizeKB * 1024; i++)
+	{
+		snprintf(line, sizeof(line), "float shade%u(float x) { return light%u(x) - %u.0; }\n", i, i, i % 89);
+		shaderCode += line;
+	}
+
+	std::ofstream(includeLocation, std::ios::binary) << includeCode;
+	std::ofstream(shaderLocation, std::ios::binary) << shaderCode;
+
+	const unsigned int loads = 200;
+	const char* names[3] = { "getline per line", "one read per file", "file cache hit" };
+	double seconds[3] = { 0.0, 0.0, 0.0 };
+	size_t loadedSize = 0;
+
+	for (int method = 0; method < 3; method++)
+	{
+		double start = mainWindow.getTime();
+		for (unsigned int i = 0; i < loads; i++)
+		{
+			if (method == 0)
+			{
+				// Can't resolve includes, so just read both files
+				std::string code = ReadFileByLine(shaderLocation.c_str()) + ReadFileByLine(includeLocation.c_str());
+				loadedSize = code.size();
+			}
+			else
+			{
+				if (method == 1)
+				{
+					ShaderSource::ClearFileCache();
+				}
+
+				ShaderSource source;
+				source.LoadFromFile(shaderLocation.c_str());
+			}
+		}
+		seconds[method] = mainWindow.getTime() - start;
+	}
+
+	std::filesystem::remove_all(directory, error);
+
+	printf("Shader source loads of %.0f KB (a file and its include), %u times:\n", loadedSize / 1024.0, loads);
+	for (int method = 0; method < 3; method++)
+	{
+		double perLoad = seconds[method] / loads;
+		printf("  %-20s %8.3f ms per load %10.1f MB/s\n", names[method], perLoad * 1000.0,
+			perLoad > 0.0 ? loadedSize / perLoad / (1024.0 * 1024.0) : 0.0);
+	}
+}
+
+// Model matrices for the keyboard keys: a 4 x 10 grid with the last key left out
+std::vector<glm::mat4> CreateKeycapTransforms()
+{
+	std::vector<glm::mat4> transforms;
+
+	glm::vec3 startPosition(-4.0f, -0.35f, -2.2f); // Starting position of the first cube
+
+	const int rows = 4;
+	const int cols = 10;
+	const float cubeSpacing = 0.11f;
+
+	for (int row = 0; row < rows; row++)
+	{
+		for (int col = 0; col < cols; col++)
+		{
+			if (col == cols - 1 && row == rows - 1)
+			{
+				break;
+			}
+
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, startPosition + glm::vec3(col * (0.25f + cubeSpacing), -0.50f, row * (0.30f + cubeSpacing)));
+			model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+			model = glm::scale(model, glm::vec3(0.1f, -0.1f, -0.1f));
+			transforms.push_back(model);
+		}
+	}
+
+	return transforms;
+}
+
+// The two mic stand cylinders, then the base under them
+std::vector<glm::mat4> CreateMicStandTransforms()
+{
+	std::vector<glm::mat4> transforms;
+
+	glm::mat4 model = glm::mat4(1.0f);
+	model = glm::translate(model, glm::vec3(-2.2f, 0.0f, -3.5f));
+	model = glm::scale(model, glm::vec3(0.2f, 3.0f, 0.2f));
+	transforms.push_back(model);
+
+	model = glm::mat4(1.0f);
+	model = glm::translate(model, glm::vec3(-2.2f, 1.55f, -3.0f));
+	model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	model = glm::scale(model, glm::vec3(0.2f, 3.0f, 0.2f));
+	transforms.push_back(model);
+
+	model = glm::mat4(1.0f);
+	model = glm::translate(model, glm::vec3(-2.2f, -0.95f, -3.5f));
+	model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
+	transforms.push_back(model);
+
+	return transforms;
+}
+
+int main(int argc, char* argv[])
+{
+	// Command line options
+	//   --headless          render offscreen (EGL surfaceless) instead of opening a window
+	//   --size <w>x<h>      framebuffer size, defaults to 800x600
+	//   --frames <n>        close after n frames
+	//   --output <file.ppm> save the last frame when closing
+	//   --bench <n>         measure n frames on a scripted camera path with a fixed timestep
+	//   --gpu-timers <n>    time each draw group on the GPU and report the averages every n frames
+	//   --trace <file.json> record CPU zones and write a chrome://tracing / Perfetto trace on exit
+	//   --vertex-bench <n>  time n draws of a dense sphere with and without the per-vertex inverse(), then exit
+	//   --no-cull           draw everything instead of skipping objects outside the view frustum
+	//   --no-shader-cache   always compile shaders instead of loading linked programs from ShaderCache/
+	//   --precompile-variants  compile every shader variant into the shader cache, then exit
+	//   --no-hot-reload     don't watch Shaders/ for edits
+	//   --shader-load-bench <kb>  time loading a generated shader source of about 2x kb, then exit
+	//   --compressed-textures  use .ktx2/.dds versions of the textures (see Tools/TextureConverter) when present
+	//   --cpu-mipmaps       build texture mip chains on the loader's workers instead of with glGenerateMipmap
+	//   --upload-ring <mb>  decode textures into a persistently mapped PBO ring of this size and upload from it
+	//   --texture-stream-bench <n>  reload a texture every n frames while the scene runs (pair with --bench)
+	//   --texture-array     pack the object textures (not the floor) into one texture array, resized to 1920x1080
+	//   --compact-vertices  store mesh vertices quantized, 16 bytes each instead of 32 (see VertexLayout.h)
+	//   --no-geometry-arena give every mesh its own VAO and buffers instead of sharing one set
+	//   --batch-bench <n>   time submitting n objects one by one and as a static batch on each draw path, then exit
+	bool headless = false;
+	int windowWidth = 800, windowHeight = 600;
+	unsigned int frameLimit = 0;
+	const char* outputLocation = NULL;
+	unsigned int benchFrames = 0;
+	unsigned int gpuReportInterval = 0;
+	const char* traceLocation = NULL;
+	unsigned int vertexBenchDraws = 0;
+	bool frustumCulling = true;
+	bool shaderCache = true;
+	bool precompileVariants = false;
+	bool hotReload = true;
+	unsigned int shaderLoadBenchKB = 0;
+	bool compressedTextures = false;
+	bool cpuMipmaps = false;
+	bool textureArray = false;
+	unsigned int uploadRingMB = 0;
+	unsigned int textureStreamInterval = 0;
+	VertexLayout meshLayout = FLOAT_VERTEX_LAYOUT;
+	bool geometryArena = true;
+	unsigned int batchBenchObjects = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			sscanf(argv[++i], "%dx%d", &windowWidth, &windowHeight);
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frameLimit = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+		{
+			outputLocation = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+		{
+			benchFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--gpu-timers") == 0 && i + 1 < argc)
+		{
+			gpuReportInterval = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+		{
+			traceLocation = argv[++i];
+		}
+		else if (strcmp(argv[i], "--vertex-bench") == 0 && i + 1 < argc)
+		{
+			vertexBenchDraws = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-cull") == 0)
+		{
+			frustumCulling = false;
+		}
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+		{
+			shaderCache = false;
+		}
+		else if (strcmp(argv[i], "--precompile-variants") == 0)
+		{
+			precompileVariants = true;
+		}
+		else if (strcmp(argv[i], "--no-hot-reload") == 0)
+		{
+			hotReload = false;
+		}
+		else if (strcmp(argv[i], "--shader-load-bench") == 0 && i + 1 < argc)
+		{
+			shaderLoadBenchKB = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--compressed-textures") == 0)
+		{
+			compressedTextures = true;
+		}
+		else if (strcmp(argv[i], "--cpu-mipmaps") == 0)
+		{
+			cpuMipmaps = true;
+		}
+		else if (strcmp(argv[i], "--upload-ring") == 0 && i + 1 < argc)
+		{
+			uploadRingMB = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--texture-stream-bench") == 0 && i + 1 < argc)
+		{
+			textureStreamInterval = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--texture-array") == 0)
+		{
+			textureArray = true;
+		}
+		else if (strcmp(argv[i], "--compact-vertices") == 0)
+		{
+			meshLayout = COMPACT_VERTEX_LAYOUT;
+		}
+		else if (strcmp(argv[i], "--no-geometry-arena") == 0)
+		{
+			geometryArena = false;
+		}
+		else if (strcmp(argv[i], "--batch-bench") == 0 && i + 1 < argc)
+		{
+			batchBenchObjects = atoi(argv[++i]);
+		}
+	}
+
+	if (traceLocation != NULL)
+	{
+		Profiler::SetEnabled(true);
+		Profiler::SetThreadName("main");
+		Profiler::MeasureZoneCost();
+	}
+
+	if (benchFrames > 0)
+	{
+		benchmark = Benchmark(benchFrames, 10, 1.0f / 60.0f, stageNames, STAGE_COUNT);
+		frameLimit = benchmark.GetFrameLimit();
+	}
+
+	// Without a window there is no way to close the program, so default to a single frame
+	if (headless && frameLimit == 0)
+	{
+		frameLimit = 1;
+	}
+
+	mainWindow = Window(windowWidth, windowHeight, headless);
+	if (mainWindow.Initialize() != 0)
+	{
+		return 1;
+	}
+	mainWindow.setFrameLimit(frameLimit);
+
+	if (shaderCache)
+	{
+		ShaderCache::Initialize("ShaderCache");
+	}
+
+	if (benchmark.IsEnabled())
+	{
+		mainWindow.setSwapInterval(0);
+	}
+
+	if (vertexBenchDraws > 0)
+	{
+		RunVertexBenchmark(vertexBenchDraws);
+		return 0;
+	}
+
+	if (shaderLoadBenchKB > 0)
+	{
+		RunShaderLoadBenchmark(shaderLoadBenchKB);
+		return 0;
+	}
+
+	// Every permutation of the default shaders; the ones not used at startup compile in the background
+	ShaderVariants defaultVariants(vShader, fShader);
+
+	if (precompileVariants)
+	{
+		double compileStart = mainWindow.getTime();
+		defaultVariants.CompileAll();
+
+		printf("Compiled %u shader variants in %.1f ms\n", defaultVariants.GetReadyCount(), (mainWindow.getTime() - compileStart) * 1000.0);
+		ShaderCache::PrintStats();
+		ShaderSource::PrintStats();
+		return 0;
+	}
+
+	if (batchBenchObjects > 0)
+	{
+		RunBatchBenchmark(defaultVariants, batchBenchObjects);
+		return 0;
+	}
+
+	if (gpuReportInterval > 0)
+	{
+		gpuTimer = GpuTimer(stageNames, STAGE_COUNT, gpuReportInterval);
+		gpuTimer.CreateQueries();
+		renderQueue.SetGpuTimer(&gpuTimer);
+	}
+
+	if (frustumCulling)
+	{
+		renderQueue.SetFrustum(&viewFrustum);
+	}
+
+	textureCache.SetPreferCompressed(compressedTextures);
+	textureCache.SetCpuMipmaps(cpuMipmaps);
+	if (textureArray)
+	{
+		textureCache.SetTextureArray(&materialTextures);
+	}
+
+	if (uploadRingMB > 0)
+	{
+		if (uploadRing.CreateRing((size_t)uploadRingMB * 1024 * 1024))
+		{
+			textureCache.SetUploadRing(&uploadRing);
+		}
+		else
+		{
+			printf("Texture upload ring unavailable, uploading from client memory\n");
+		}
+	}
+
+	// Room for a hundred times this scene's geometry, so props can be added without growing it
+	if (geometryArena)
+	{
+		staticGeometry.CreateArena(meshLayout, 65536, 196608);
+	}
 
 
 	// Function calls
-	CreateObjects();
-	CreateShaders();
+	{
+		double loadStart = mainWindow.getTime();
 
-	// position, worldup, yaw, pitch, move speed, turn speed (mouse control)
-	camera = Camera(glm::vec3(0.0f, 0.5f, 2.5f), glm::vec3(0.0f, 2.0f, 0.0f), -90.0f, 0.0f, 5.0f, 0.5f);
+		// JPEG decoding and vertex generation run on the workers while this thread compiles shaders,
+		// then each result is uploaded as soon as it arrives
+		AssetLoader loader;
 
-	// Textures for all objects
-	planeTexture = Texture("Textures/woodTex.jpg");
-	planeTexture.LoadTexture();
+		LoadTextures(loader);
+		CreateObjects(loader, meshLayout, geometryArena ? &staticGeometry : NULL);
+		CreateShaders(defaultVariants, textureArray);
 
-	keyboardTexture = Texture("Textures/blackTex.jpg");
-	keyboardTexture.LoadTexture();
+		loader.WaitAll();
+
+		printf("Assets loaded in %.1f ms on %u worker threads\n", (mainWindow.getTime() - loadStart) * 1000.0, loader.GetWorkerCount());
+		ShaderCache::PrintStats();
+		textureCache.PrintStats();
+		if (textureArray)
+		{
+			printf("Texture array: %d of %d layers used (%.1f MB)\n", materialTextures.GetLayerCount(), materialTextures.GetLayerCapacity(), materialTextures.GetResidentBytes() / (1024.0 * 1024.0));
+		}
+
+		size_t vertexBytes = 0, indexBytes = 0, wideIndexBytes = 0;
+		for (size_t i = 0; i < meshList.size(); i++)
+		{
+			vertexBytes += meshList[i]->GetVertexBytes();
+			indexBytes += meshList[i]->GetIndexBytes();
+			wideIndexBytes += meshList[i]->GetIndexCount() * sizeof(GLuint);
+		}
+		VertexAttribute attributes[3];
+		printf("Mesh vertices: %.1f KB at %d bytes each\n", vertexBytes / 1024.0, GetVertexAttributes(meshLayout, attributes));
+		printf("Mesh indices: %.1f KB (%.1f KB saved over 32-bit indices)\n", indexBytes / 1024.0, (wideIndexBytes - indexBytes) / 1024.0);
+		staticGeometry.PrintStats();
+	}
+
+	defaultVariants.CompileRemainingInBackground(&mainWindow);
+
+	// Saved shader edits are rebuilt off the frame and swapped in once they link
+	FileWatcher shaderWatcher;
+	if (hotReload && !shaderWatcher.Watch("Shaders"))
+	{
+		printf("Shader hot reload disabled, can't watch Shaders/\n");
+	}
 
-	mousepadTexture = Texture("Textures/designTex.jpg");
-	mousepadTexture.LoadTexture();
+	// Edited textures, and the ones --texture-stream-bench reloads, decode here while frames keep going
+	AssetLoader streamLoader(1);
+	FileWatcher textureWatcher;
+	if (hotReload && !textureWatcher.Watch("Textures"))
+	{
+		printf("Texture hot reload disabled, can't watch Textures/\n");
+	}
 
-	keycapTexture = Texture("Textures/grayTex.jpg");
-	keycapTexture.LoadTexture();
+	// The keys never move, so their instance buffer is filled once
+	std::vector<glm::mat4> keycapTransforms = CreateKeycapTransforms();
+	meshList[2]->UpdateInstances(keycapTransforms.data(), (GLsizei)keycapTransforms.size());
 
-	micstandTexture = Texture("Textures/blueTex.jpg");
-	micstandTexture.LoadTexture();
+	// The mic stand and its base never move and share texture and material, so they're drawn as
+	// one batch when they share the geometry arena (the other objects each have their own texture)
+	std::vector<glm::mat4> micStandTransforms = CreateMicStandTransforms();
+	StaticBatch micStandBatch;
+	if (geometryArena && micstandTexture == baseTexture)
+	{
+		micStandBatch.AddObject(meshList[3], micStandTransforms[0]);
+		micStandBatch.AddObject(meshList[3], micStandTransforms[1]);
+		micStandBatch.AddObject(meshList[6], micStandTransforms[2]);
+		micStandBatch.BuildBatch(StaticBatch::GetBestPath());
+	}
 
-	micTexture = Texture("Textures/meshTex.jpg");
-	micTexture.LoadTexture();
+	// position, worldup, yaw, pitch, move speed, turn speed (mouse control)
+	camera = Camera(glm::vec3(0.0f, 0.5f, 2.5f), glm::vec3(0.0f, 2.0f, 0.0f), -90.0f, 0.0f, 5.0f, 0.5f);
 
 	// Specular Lighting
 	shinyMaterial = Material(1.0f, 16);
@@ -414,195 +1184,277 @@ int main()
 	// Lighting       r |   g |   b |  amb | dir x | dir y | dir z | intensity
 	mainLight = Light(1.0f, 1.0f, 1.0f, 0.05f, 1.0f, 0.0f, -1.0f, 0.5f); // plain bright white light
 
-	GLuint uniformProjection = 0, 
-		   uniformModel = 0, 
-		   uniformView = 0, 
-		   uniformAmbientIntensity = 0, 
-		   uniformAmbientColor = 0,
-		   uniformDirection = 0,
-		   uniformDiffuseIntensity = 0,
-	       uniformEyePosition = 0,
-		   uniformSpecularIntensity = 0,
-		   uniformShininess = 0
-		;
+	// Camera and light go to every program through one uniform buffer; model and material
+	// uniforms are looked up by the render queue per shader
+	frameUniforms.CreateBuffer();
+	PerFrameData perFrame = {}; // lights past the first stay black for the multi-light variants
 
 
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 100.0f);
 
 
+	double loopStart = mainWindow.getTime();
+	bool outputSaved = false;
+	GLState::ResetCounters(); // only what the frames bind, not loading
+
 	// Loop until window closed
 	while (!mainWindow.getShouldClose())
 	{
-		GLfloat now = glfwGetTime(); // SDL_GetPerformanceCounter();
-		deltaTime = now - lastTime; // converts into a value in seconds -> (now - lastTime)*1000/SDL_GetPerformanceFrequency();
-		lastTime = now;
+		PROFILE_ZONE("frame");
 
-		// Get + Handle User Input
-		glfwPollEvents();
+		benchmark.BeginFrame();
+		gpuTimer.BeginFrame();
 
-		// Checks what keys are being pressed to move the camera
-		camera.keyControl(mainWindow.getsKeys(), deltaTime);
-		camera.mouseControl(mainWindow.getXChange(), mainWindow.getYChange());
+		// Get + Handle User Input, unless a benchmark is driving the camera
+		{
+			PROFILE_ZONE("input");
 
+			mainWindow.pollEvents();
 
+			std::vector<std::string> changedShaders = shaderWatcher.PollChanges();
+			for (size_t i = 0; i < changedShaders.size(); i++)
+			{
+				defaultVariants.ReloadIfSource(changedShaders[i]);
+			}
+			defaultVariants.PumpReloads();
 
-		// Check for 'P' key press to toggle between orthographic and perspective views
-		if (mainWindow.getsKeys()[GLFW_KEY_P])
-		{
-			isPerspective = !isPerspective;
-		}
+			std::vector<std::string> changedTextures = textureWatcher.PollChanges();
+			for (size_t i = 0; i < changedTextures.size(); i++)
+			{
+				textureCache.Reload(("Textures/" + changedTextures[i]).c_str(), &streamLoader);
+			}
 
-		// Set the projection matrix accordingly
-		if (isPerspective)
-		{
-			projection = glm::perspective(glm::radians(45.0f), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 100.0f);
-		}
-		else
-		{
-			// Set up an orthographic projection matrix
-			GLfloat left = -1.0f;
-			GLfloat right = 1.0f;
-			GLfloat bottom = -1.0f;
-			GLfloat top = 1.0f;
-			GLfloat near = 0.1f;
-			GLfloat far = 100.0f;
+			unsigned int frame = mainWindow.getFrameCount();
+			if (textureStreamInterval > 0 && frame > 0 && frame % textureStreamInterval == 0)
+			{
+				const size_t streamedCount = sizeof(streamedTextures) / sizeof(streamedTextures[0]);
+				textureCache.Reload(streamedTextures[(frame / textureStreamInterval) % streamedCount], &streamLoader);
+			}
 
-			projection = glm::ortho(left, right, bottom, top, near, far);
-		}
+			streamLoader.PumpUploads();
+			uploadRing.Retire();
 
+			if (benchmark.IsEnabled())
+			{
+				// Scripted camera and a fixed timestep so every run renders exactly the same frames
+				deltaTime = benchmark.GetTimeStep();
 
-		// Clear the window
-		glClearColor(0.1f, 0.15f, 0.2f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
+				glm::vec3 benchPosition;
+				GLfloat benchYaw, benchPitch;
+				benchmark.GetCameraPose(mainWindow.getFrameCount(), benchPosition, benchYaw, benchPitch);
+				camera.setPose(benchPosition, benchYaw, benchPitch);
+			}
+			else
+			{
+				GLfloat now = mainWindow.getTime(); // SDL_GetPerformanceCounter();
+				deltaTime = now - lastTime; // converts into a value in seconds -> (now - lastTime)*1000/SDL_GetPerformanceFrequency();
+				lastTime = now;
 
-		shaderList[0].UseShader();
-		uniformModel = shaderList[0].GetModelLocation();
-		uniformProjection = shaderList[0].GetProjectionLocation();
-		uniformView = shaderList[0].GetViewLocation();
-		uniformAmbientColor = shaderList[0].GetAmbientColorLocation();
-		uniformAmbientIntensity = shaderList[0].GetAmbientIntensityLocation();
-		uniformDirection = shaderList[0].GetDirectionLocation();
-		uniformDiffuseIntensity = shaderList[0].GetDiffuseIntensityLocation();
-		uniformEyePosition = shaderList[0].GetEyePositionLocation();
+				// Checks what keys are being pressed to move the camera
+				camera.keyControl(mainWindow.getsKeys(), deltaTime);
+				camera.mouseControl(mainWindow.getXChange(), mainWindow.getYChange());
 
+				// Check for 'P' key press to toggle between orthographic and perspective views
+				if (mainWindow.getsKeys()[GLFW_KEY_P])
+				{
+					isPerspective = !isPerspective;
+				}
+			}
 
-		// Use the lighting
-		mainLight.UseLight(uniformAmbientIntensity, uniformAmbientColor, uniformDirection, uniformDiffuseIntensity);
+			// Set the projection matrix accordingly
+			if (isPerspective)
+			{
+				projection = glm::perspective(glm::radians(45.0f), mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 100.0f);
+			}
+			else
+			{
+				// Set up an orthographic projection matrix
+				GLfloat left = -1.0f;
+				GLfloat right = 1.0f;
+				GLfloat bottom = -1.0f;
+				GLfloat top = 1.0f;
+				GLfloat near = 0.1f;
+				GLfloat far = 100.0f;
+
+				projection = glm::ortho(left, right, bottom, top, near, far);
+			}
 
-		// The uniform projection and view only need to be set once as long as it's set before we draw
-		glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(camera.calculateViewMatrix()));
-		glUniform3f(uniformEyePosition, camera.getCameraPosition().x, camera.getCameraPosition().y, camera.getCameraPosition().z);
+			benchmark.EndStage(STAGE_INPUT);
+		}
 
 		glm::mat4 model = glm::mat4(1.0f);
 
+		// Clear the window and set the per-frame uniforms
+		{
+			PROFILE_ZONE("uniform setup");
+
+			glClearColor(0.1f, 0.15f, 0.2f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		
 
+			// Uploaded once; every program reads it through its PerFrame block
+			perFrame.projection = projection;
+			perFrame.view = camera.calculateViewMatrix();
+			perFrame.eyePosition = camera.getCameraPosition();
+			perFrame.padding = 0.0f;
+
+			// Use the lighting
+			mainLight.UseLight(perFrame.directionalLights[0]);
+
+			frameUniforms.Update(perFrame);
+
+			// Objects are culled against this as they're queued
+			viewFrustum.Extract(perFrame.projection * perFrame.view);
+			renderQueue.Begin();
+
+			benchmark.EndStage(STAGE_UNIFORMS);
+		}
+
+		// Queue the objects; nothing is drawn until the queue is flushed in state order below
 		// Render the plane
-		model = glm::translate(model, glm::vec3(0.0f, -1.0f, -2.0f));
-		model = glm::scale(model, glm::vec3(10.0f, 0.0f, 10.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		planeTexture.UseTexture();
-		dullMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[0]->RenderMesh();
+		{
+			PROFILE_ZONE("draw plane");
+
+			model = glm::translate(model, glm::vec3(0.0f, -1.0f, -2.0f));
+			model = glm::scale(model, glm::vec3(10.0f, 0.0f, 10.0f));
+			renderQueue.Submit(GetTexturedShader(planeTexture.get(), false), meshList[0], planeTexture.get(), &dullMaterial, model, STAGE_PLANE);
+			benchmark.EndStage(STAGE_PLANE);
+		}
 
 		// Render the mouse pad
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(2.5f, -2.0f, -1.0f));
-		model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		model = glm::scale(model, glm::vec3(2.05f, 4.0f, 4.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		mousepadTexture.UseTexture();
-		dullMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[1]->RenderMesh();
+		{
+			PROFILE_ZONE("draw mousepad");
+
+			model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(2.5f, -2.0f, -1.0f));
+			model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+			model = glm::scale(model, glm::vec3(2.05f, 4.0f, 4.0f));
+			renderQueue.Submit(GetTexturedShader(mousepadTexture.get(), false), meshList[1], mousepadTexture.get(), &dullMaterial, model, STAGE_MOUSEPAD);
+			benchmark.EndStage(STAGE_MOUSEPAD);
+		}
 
 		// Render the keyboard
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.2f, -0.89f, -1.5f));
-		model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(1.0f, 0.1f, 2.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		keyboardTexture.UseTexture();
-		dullMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[2]->RenderMesh();
+		{
+			PROFILE_ZONE("draw keyboard");
+
+			model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(-2.2f, -0.89f, -1.5f));
+			model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			model = glm::scale(model, glm::vec3(1.0f, 0.1f, 2.0f));
+			renderQueue.Submit(GetTexturedShader(keyboardTexture.get(), false), meshList[2], keyboardTexture.get(), &dullMaterial, model, STAGE_KEYBOARD);
+			benchmark.EndStage(STAGE_KEYBOARD);
+		}
 
 		// Render the keyboard keys
-		glm::vec3 startPosition(-4.0f, -0.35f, -2.2f); // Starting position of the first cube
-		
-		const int rows = 4;
-		const int cols = 10;
-		const float cubeSpacing = 0.11f;
-
-		for (int row = 0; row < rows; row++)
 		{
-			for (int col = 0; col < cols; col++)
-			{
-				model = glm::mat4(1.0f);
-				model = glm::translate(model, startPosition + glm::vec3(col * (0.25f + cubeSpacing), -0.50f, row * (0.30f + cubeSpacing)));
-				model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-				model = glm::scale(model, glm::vec3(0.1f, -0.1f, -0.1f));
-				glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-			    keycapTexture.UseTexture();
-
-				if (col == cols - 1 && row == rows - 1)
-				{
-					break;
-				}
+			PROFILE_ZONE("draw keycaps");
 
-				meshList[2]->RenderMesh();
-			}
+			// Every key in a single instanced draw (transforms were uploaded at startup)
+			renderQueue.SubmitInstanced(GetTexturedShader(keycapTexture.get(), true), meshList[2], keycapTexture.get(), &dullMaterial, STAGE_KEYCAPS);
+			benchmark.EndStage(STAGE_KEYCAPS);
 		}
 
 		// Render the mic stand
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.2f, 0.0f, -3.5f));
-		model = glm::scale(model, glm::vec3(0.2f, 3.0f, 0.2f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		micstandTexture.UseTexture();
-		dullMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[3]->RenderMesh();
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.2f, 1.55f, -3.0f));
-		model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.2f, 3.0f, 0.2f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		micstandTexture.UseTexture();
-		dullMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[3]->RenderMesh();
+		{
+			PROFILE_ZONE("draw mic stand");
+
+			// The batch takes the base along, so it isn't culled or timed on its own
+			if (micStandBatch.GetObjectCount() > 0)
+			{
+				renderQueue.SubmitBatch(GetBatchedShader(micstandTexture.get()), &micStandBatch, micstandTexture.get(), &dullMaterial, STAGE_MICSTAND);
+			}
+			else
+			{
+				renderQueue.Submit(GetTexturedShader(micstandTexture.get(), false), meshList[3], micstandTexture.get(), &dullMaterial, micStandTransforms[0], STAGE_MICSTAND);
+				renderQueue.Submit(GetTexturedShader(micstandTexture.get(), false), meshList[3], micstandTexture.get(), &dullMaterial, micStandTransforms[1], STAGE_MICSTAND);
+			}
+			benchmark.EndStage(STAGE_MICSTAND);
+		}
 
 		// Render mic body (cone)
 		/*model = glm::mat4(1.0f);
 		model = glm::translate(model, glm::vec3(-2.2f, 1.55f, -3.0f));
 		model = glm::scale(model, glm::vec3(2.0f, 2.0f, 2.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		micTexture.UseTexture();
-		shinyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[4]->RenderMesh();*/
+		renderQueue.Submit(shaderList[0], meshList[4], micTexture.get(), &shinyMaterial, model, STAGE_MIC);*/
 
 		// Render mic
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.2f, 1.55f, -1.5f));
-		model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		micTexture.UseTexture();
-		shinyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[5]->RenderMesh();
+		{
+			PROFILE_ZONE("draw mic");
+
+			model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(-2.2f, 1.55f, -1.5f));
+			model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
+			renderQueue.Submit(GetTexturedShader(micTexture.get(), false), meshList[5], micTexture.get(), &shinyMaterial, model, STAGE_MIC);
+			benchmark.EndStage(STAGE_MIC);
+		}
 
 		// Render micstand base
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-2.2f, -0.95f, -3.5f));
-		model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		micstandTexture.UseTexture();
-		dullMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[6]->RenderMesh();
-
-		// Unassign the shader program when done
-		glUseProgram(0);
-
-		mainWindow.swapBuffers();
+		{
+			PROFILE_ZONE("draw base");
+
+			if (micStandBatch.GetObjectCount() == 0)
+			{
+				renderQueue.Submit(GetTexturedShader(baseTexture.get(), false), meshList[6], baseTexture.get(), &dullMaterial, micStandTransforms[2], STAGE_BASE);
+			}
+			benchmark.EndStage(STAGE_BASE);
+		}
+
+		// Sort by state and draw everything queued above
+		{
+			PROFILE_ZONE("flush queue");
+
+			renderQueue.Flush();
+			benchmark.EndStage(STAGE_FLUSH);
+		}
+
+		gpuTimer.EndFrame();
+
+		// Saved before the swap, after which the window's back buffer is undefined
+		if (outputLocation != NULL && mainWindow.isLastFrame())
+		{
+			outputSaved = mainWindow.saveFramebuffer(outputLocation);
+		}
+
+		{
+			PROFILE_ZONE("swap");
+
+			mainWindow.swapBuffers();
+
+			// Wait for the GPU so benchmark frame times cover the whole frame, not just submission
+			if (benchmark.IsEnabled())
+			{
+				glFinish();
+			}
+
+			benchmark.EndStage(STAGE_SWAP);
+		}
+		benchmark.EndFrame();
+	}
+
+	benchmark.PrintReport();
+	renderQueue.PrintStats();
+	GLState::PrintStats(mainWindow.getFrameCount());
+	gpuTimer.PrintReport();
+	gpuTimer.ClearQueries();
+	micStandBatch.ClearBatch();
+	frameUniforms.ClearBuffer();
+	streamLoader.WaitAll(); // its workers may still be writing into the ring
+	uploadRing.PrintStats();
+	uploadRing.ClearRing();
+
+	if (traceLocation != NULL)
+	{
+		// The background compiler records zones as well, and may still be working through the variants
+		defaultVariants.WaitForBackground();
+
+		Profiler::PrintOverhead(mainWindow.getFrameCount(), mainWindow.getTime() - loopStart);
+		Profiler::WriteChromeTrace(traceLocation);
+	}
+
+	// Closed by hand rather than by --frames: the last frame is the one on screen
+	if (outputLocation != NULL && !outputSaved)
+	{
+		mainWindow.saveFramebuffer(outputLocation, true);
 	}
 
 	return 0;